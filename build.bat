@@ -18,10 +18,25 @@ if %errorlevel% neq 0 (
     exit /b 1
 )
 
+echo Compiling Twine runtime library...
+
+set RUNTIME_FLAGS=-std=c++17 -O2 -fno-exceptions -fno-rtti
+if not exist build\runtime mkdir build\runtime
+
+for %%s in (array string io math bytemap search reduce sort map intern cpu) do (
+    g++ %RUNTIME_FLAGS% -c runtime\%%s.cpp -o build\runtime\%%s.o
+    if errorlevel 1 (
+        echo Runtime build failed!
+        pause
+        exit /b 1
+    )
+)
+ar rcs libtwinert.a build\runtime\array.o build\runtime\string.o build\runtime\io.o build\runtime\math.o build\runtime\bytemap.o build\runtime\search.o build\runtime\reduce.o build\runtime\sort.o build\runtime\map.o build\runtime\intern.o build\runtime\cpu.o
+
 echo Compiling Twine Compiler with g++...
 
 REM Get LLVM flags
-for /f %%i in ('llvm-config --cxxflags --ldflags --system-libs --libs core support irreader codegen mc mcparser option target') do set LLVM_FLAGS=%%i
+for /f %%i in ('llvm-config --cxxflags --ldflags --system-libs --libs core support irreader codegen mc mcparser option target linker') do set LLVM_FLAGS=%%i
 
 REM Compile with proper include path
 g++ -std=c++17 -Iinclude -o twine.exe src/main.cpp src/lexer.cpp src/parser.cpp src/ast.cpp src/codegen.cpp %LLVM_FLAGS%
@@ -34,6 +49,7 @@ if %errorlevel% neq 0 (
 
 echo Build successful!
 echo Compiler is at: twine.exe
+echo Runtime library is at: libtwinert.a
 echo.
 echo Example usage:
 echo   twine.exe examples\fibonacci.tw
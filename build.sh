@@ -21,10 +21,32 @@ if ! command -v g++ &> /dev/null; then
     exit 1
 fi
 
+echo "Compiling Twine runtime library..."
+
+RUNTIME_SOURCES="runtime/array.cpp runtime/string.cpp runtime/io.cpp runtime/math.cpp runtime/bytemap.cpp runtime/search.cpp runtime/reduce.cpp runtime/sort.cpp runtime/map.cpp runtime/intern.cpp runtime/cpu.cpp"
+RUNTIME_FLAGS="-std=c++17 -O2 -fno-exceptions -fno-rtti"
+mkdir -p build/runtime
+
+for src in $RUNTIME_SOURCES; do
+    g++ $RUNTIME_FLAGS -fPIC -c $src -o build/runtime/$(basename $src .cpp).o || { echo "Runtime build failed!"; exit 1; }
+done
+ar rcs libtwinert.a build/runtime/*.o
+
+# Bitcode lets the compiler inline builtins; it needs a clang matching LLVM
+LLVM_BINDIR=$(llvm-config --bindir)
+if [ -x "$LLVM_BINDIR/clang++" ] && [ -x "$LLVM_BINDIR/llvm-link" ]; then
+    for src in $RUNTIME_SOURCES; do
+        "$LLVM_BINDIR/clang++" $RUNTIME_FLAGS -emit-llvm -c $src -o build/runtime/$(basename $src .cpp).bc || { echo "Runtime bitcode build failed!"; exit 1; }
+    done
+    "$LLVM_BINDIR/llvm-link" build/runtime/*.bc -o twinert.bc
+else
+    echo "clang++ not found in $LLVM_BINDIR, skipping runtime bitcode"
+fi
+
 echo "Compiling Twine Compiler with g++..."
 
 # Get LLVM flags
-LLVM_FLAGS=$(llvm-config --cxxflags --ldflags --system-libs --libs core support irreader codegen mc mcparser option target)
+LLVM_FLAGS=$(llvm-config --cxxflags --ldflags --system-libs --libs core support irreader codegen mc mcparser option target linker)
 
 # Compile with proper include path
 g++ -std=c++17 -Iinclude -o twine src/main.cpp src/lexer.cpp src/parser.cpp src/ast.cpp src/codegen.cpp $LLVM_FLAGS
@@ -36,6 +58,7 @@ fi
 
 echo "Build successful!"
 echo "Compiler is at: twine"
+echo "Runtime library is at: libtwinert.a"
 echo ""
 echo "Example usage:"
 echo "  ./twine examples/fibonacci.tw"
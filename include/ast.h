@@ -80,6 +80,18 @@ public:
     void accept(ASTVisitor* visitor) override;
 };
 
+// cond ? thenValue : elseValue
+class ConditionalExpression : public Expression {
+public:
+    std::unique_ptr<Expression> condition;
+    std::unique_ptr<Expression> thenValue;
+    std::unique_ptr<Expression> elseValue;
+    
+    ConditionalExpression(std::unique_ptr<Expression> c, std::unique_ptr<Expression> t, std::unique_ptr<Expression> e)
+        : condition(std::move(c)), thenValue(std::move(t)), elseValue(std::move(e)) {}
+    void accept(ASTVisitor* visitor) override;
+};
+
 class AssignmentExpression : public Expression {
 public:
     std::string name;
@@ -90,6 +102,22 @@ public:
     void accept(ASTVisitor* visitor) override;
 };
 
+// target op= value, where target is a variable or an indexed element.
+// ++ and -- are the same with a value of 1; postfix ones produce the old
+// value instead of the new one.
+class CompoundAssignmentExpression : public Expression {
+public:
+    std::unique_ptr<Expression> target;
+    std::string op;   // the arithmetic operator: "+", "-", "*", "/" or "%"
+    std::unique_ptr<Expression> value;
+    bool postfix;
+    
+    CompoundAssignmentExpression(std::unique_ptr<Expression> t, const std::string& o,
+                                 std::unique_ptr<Expression> v, bool post = false)
+        : target(std::move(t)), op(o), value(std::move(v)), postfix(post) {}
+    void accept(ASTVisitor* visitor) override;
+};
+
 class IndexAssignmentExpression : public Expression {
 public:
     std::unique_ptr<Expression> array;
@@ -182,10 +210,19 @@ public:
     void accept(ASTVisitor* visitor) override;
 };
 
+// Hints from @vectorize(n), @unroll(n) and @fastmath in front of a loop.
+// A count of 0 leaves the choice to LLVM; 1 turns the transform off.
+struct LoopHints {
+    int vectorizeWidth = 0;
+    int unrollCount = 0;
+    bool fastMath = false;
+};
+
 class WhileStatement : public Statement {
 public:
     std::unique_ptr<Expression> condition;
     std::unique_ptr<Statement> body;
+    LoopHints hints;
     
     WhileStatement(std::unique_ptr<Expression> cond, std::unique_ptr<Statement> b)
         : condition(std::move(cond)), body(std::move(b)) {}
@@ -198,6 +235,7 @@ public:
     std::unique_ptr<Expression> condition;
     std::unique_ptr<Expression> update;
     std::unique_ptr<Statement> body;
+    LoopHints hints;
     
     ForStatement(std::unique_ptr<Statement> i,
                  std::unique_ptr<Expression> c,
@@ -208,6 +246,50 @@ public:
     void accept(ASTVisitor* visitor) override;
 };
 
+// for (let x in iterable): x takes each element of an array, or each
+// character of a string
+class ForInStatement : public Statement {
+public:
+    std::string name;
+    std::unique_ptr<Expression> iterable;
+    std::unique_ptr<Statement> body;
+    LoopHints hints;
+    
+    ForInStatement(const std::string& n, std::unique_ptr<Expression> it, std::unique_ptr<Statement> b)
+        : name(n), iterable(std::move(it)), body(std::move(b)) {}
+    void accept(ASTVisitor* visitor) override;
+};
+
+// One `case value:` (or `default:`, with no value) and the statements up
+// to the next label. Control falls through into the next case unless the
+// statements break.
+struct SwitchCase {
+    std::unique_ptr<Expression> value;
+    std::vector<std::unique_ptr<Statement>> body;
+};
+
+class SwitchStatement : public Statement {
+public:
+    std::unique_ptr<Expression> discriminant;
+    std::vector<SwitchCase> cases;
+    
+    SwitchStatement(std::unique_ptr<Expression> d, std::vector<SwitchCase> c)
+        : discriminant(std::move(d)), cases(std::move(c)) {}
+    void accept(ASTVisitor* visitor) override;
+};
+
+// break applies to the innermost enclosing loop or switch, continue to the
+// innermost loop
+class BreakStatement : public Statement {
+public:
+    void accept(ASTVisitor* visitor) override;
+};
+
+class ContinueStatement : public Statement {
+public:
+    void accept(ASTVisitor* visitor) override;
+};
+
 class ReturnStatement : public Statement {
 public:
     std::unique_ptr<Expression> value;
@@ -253,8 +335,10 @@ public:
     virtual void visit(Identifier* node) = 0;
     virtual void visit(BinaryExpression* node) = 0;
     virtual void visit(UnaryExpression* node) = 0;
+    virtual void visit(ConditionalExpression* node) = 0;
     virtual void visit(AssignmentExpression* node) = 0;
     virtual void visit(IndexAssignmentExpression* node) = 0;
+    virtual void visit(CompoundAssignmentExpression* node) = 0;
     virtual void visit(CallExpression* node) = 0;
     virtual void visit(ArrayLiteral* node) = 0;
     virtual void visit(IndexExpression* node) = 0;
@@ -264,6 +348,10 @@ public:
     virtual void visit(IfStatement* node) = 0;
     virtual void visit(WhileStatement* node) = 0;
     virtual void visit(ForStatement* node) = 0;
+    virtual void visit(ForInStatement* node) = 0;
+    virtual void visit(SwitchStatement* node) = 0;
+    virtual void visit(BreakStatement* node) = 0;
+    virtual void visit(ContinueStatement* node) = 0;
     virtual void visit(ReturnStatement* node) = 0;
     virtual void visit(FunctionDeclaration* node) = 0;
 };
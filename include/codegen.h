@@ -18,9 +18,26 @@
 #include <memory>
 #include <vector>
 #include <stack>
+#include <set>
 
 class CodeGenerator : public ASTVisitor {
 private:
+    // What a value is at the language level. Strings, arrays and maps all
+    // share the LLVM pointer type, so this is tracked alongside it.
+    enum class ValueKind {
+        Unknown,
+        Number,
+        String,
+        Array,          // number array (f64 elements)
+        Int32Array,
+        Int64Array,
+        Float32Array,
+        BitArray,
+        AnyArray,       // some array; element type only known from the tag
+        Map
+    };
+    
+
     std::unique_ptr<llvm::LLVMContext> context;
     std::unique_ptr<llvm::Module> module;
     std::unique_ptr<llvm::IRBuilder<>> builder;
@@ -32,9 +49,29 @@ private:
     
     std::stack<llvm::Value*> valueStack;
     
+    std::map<llvm::AllocaInst*, ValueKind> variableKinds;
+    std::map<std::string, llvm::GlobalVariable*> internedLiterals;
+    std::map<std::string, llvm::MDNode*> tbaaTags;
+    
+    // Where break and continue go, innermost last. A switch only takes
+    // break, so its continueBlock is null.
+    struct LoopTarget {
+        llvm::BasicBlock* breakBlock;
+        llvm::BasicBlock* continueBlock;
+    };
+    std::vector<LoopTarget> loopTargets;
+    
+    // Function multiversioning (--target-clones)
+    std::vector<std::string> targetClones;
+    std::set<llvm::Function*> functionsWithLoops;
+    
+    // Target glibc as major * 100 + minor, 0 if unknown (--glibc)
+    int glibcVersion = 0;
+    
     llvm::AllocaInst* createEntryBlockAlloca(llvm::Function* function, 
                                               const std::string& varName,
                                               llvm::Type* type);
+    llvm::AllocaInst* findVariable(const std::string& name);
     llvm::Value* getVariable(const std::string& name);
     void setVariable(const std::string& name, llvm::Value* value);
     void pushScope();
@@ -63,6 +100,8 @@ private:
     llvm::Function* declareSqrt();
     llvm::Function* declareRand();
     llvm::Function* declareSrand();
+    void markMathFunction(llvm::Function* func);
+    llvm::Value* createMathCall(llvm::Function* func, const std::vector<llvm::Value*>& args);
     
     // String
     void declareStrlen();
@@ -70,15 +109,58 @@ private:
     void declareStrcpy();
     void declareStrcat();
     void declareStrstr();
+
+    // Arrays
+    static constexpr unsigned ARRAY_ALIGNMENT = 64;
+    llvm::Value* createArrayAlloc(llvm::Value* count);
+    llvm::Value* markArrayResult(llvm::CallInst* call, bool freshAllocation = true);
+    llvm::Value* loadArrayCount(llvm::Value* arrayPtr);
+    void createArrayFill(llvm::Value* dataPtr, llvm::Value* count, llvm::Value* value);
+    
+    // Static kinds
+    ValueKind expressionKind(Expression* expr);
+    void recordVariableKind(const std::string& name, ValueKind kind);
+    static bool isTypedArrayKind(ValueKind kind);
+    static bool isArrayKind(ValueKind kind);
+    void joinLoopVariableKinds(const std::vector<ASTNode*>& loopParts);
+    bool isSpeculatable(Expression* expr, int& budget);
+    llvm::Value* createElementAddress(ValueKind kind, llvm::Value* arrayPtr, llvm::Value* index);
+    llvm::Value* createElementLoad(ValueKind kind, llvm::Value* elementPtr, llvm::Value* index);
+    void createElementStore(ValueKind kind, llvm::Value* elementPtr, llvm::Value* index, llvm::Value* value);
+    
+    // range(): fused into for-in loops and reductions, built otherwise
+    static CallExpression* asRangeCall(Expression* expr);
+    void createRangeBounds(CallExpression* range, llvm::Value*& start, llvm::Value*& step, llvm::Value*& count);
+    llvm::Value* createRangeReduction(CallExpression* node, CallExpression* range);
+    
+    // Alias analysis
+    llvm::MDNode* getTBAATag(const std::string& typeName);
+    void tagAccess(llvm::Value* access, const std::string& typeName);
+    static const char* elementTBAAType(ValueKind kind);
+    
+    // Loops
+    void attachLoopHints(llvm::Instruction* backEdge, const LoopHints& hints);
+    bool emitCountedFor(ForStatement* node);
+    
+    // String interning
+    void emitLiteralInterning();
+
+    // Runtime library (libtwinert)
+    llvm::Function* declareRuntimeFunction(const std::string& name,
+                                           llvm::Type* returnType,
+                                           const std::vector<llvm::Type*>& params);
     
     // Conversion
     llvm::Value* convertToDouble(llvm::Value* value);
     llvm::Value* convertToInt(llvm::Value* value);
     llvm::Value* convertToBool(llvm::Value* value);
-    llvm::Value* convertToString(llvm::Value* value);
     
     llvm::Value* getInt64(int64_t value);
     llvm::Value* createStringConcatenation(llvm::Value* left, llvm::Value* right);
+    llvm::Value* createArithmetic(const std::string& op, llvm::Value* left, llvm::Value* right);
+    llvm::Value* createIntegerExpression(Expression* expr);
+    llvm::Value* toInt64(llvm::Value* value);
+    llvm::Value* toCount(llvm::Value* value);
     
     // Runtime boxing/unboxing
     llvm::Value* boxValue(llvm::Value* value);
@@ -93,7 +175,24 @@ public:
     CodeGenerator(const std::string& moduleName);
     ~CodeGenerator();
     
+    // Relaxed floating point (reassociation, contraction, no signed zeros) for
+    // the whole module; @fastmath enables the same for a single loop
+    void setFastMath(bool enabled);
+    
+    // ISA levels to clone loop-carrying functions for, e.g. {"avx2"}.
+    // Returns false for an unknown name. Must be set before generate().
+    bool setTargetClones(const std::vector<std::string>& isas);
+    
+    // Oldest glibc the program will run against, e.g. (2, 35). Enables
+    // libmvec variants that older versions lack.
+    void setGlibcVersion(int major, int minor);
+    
     bool generate(Program* program);
+    bool linkRuntime(const std::string& bitcodeFile);
+    void emitTargetClones();
+    // Declares libmvec variants of math calls for x86-64 GNU targets. Must
+    // run after linkRuntime(), which sets the target triple.
+    void emitVectorMathVariants();
     
     void dumpIR();
     bool writeIRToFile(const std::string& filename);
@@ -107,8 +206,10 @@ public:
     void visit(Identifier* node) override;
     void visit(BinaryExpression* node) override;
     void visit(UnaryExpression* node) override;
+    void visit(ConditionalExpression* node) override;
     void visit(AssignmentExpression* node) override;
     void visit(IndexAssignmentExpression* node) override;
+    void visit(CompoundAssignmentExpression* node) override;
     void visit(CallExpression* node) override;
     void visit(ArrayLiteral* node) override;
     void visit(IndexExpression* node) override;
@@ -118,6 +219,10 @@ public:
     void visit(IfStatement* node) override;
     void visit(WhileStatement* node) override;
     void visit(ForStatement* node) override;
+    void visit(ForInStatement* node) override;
+    void visit(SwitchStatement* node) override;
+    void visit(BreakStatement* node) override;
+    void visit(ContinueStatement* node) override;
     void visit(ReturnStatement* node) override;
     void visit(FunctionDeclaration* node) override;
 };
@@ -21,6 +21,12 @@ enum class TokenType {
     ELSE,
     WHILE,
     FOR,
+    IN,
+    BREAK,
+    CONTINUE,
+    SWITCH,
+    CASE,
+    DEFAULT,
     RETURN,
     TRUE,
     FALSE,
@@ -33,6 +39,13 @@ enum class TokenType {
     DIVIDE,
     MODULO,
     ASSIGN,
+    PLUS_ASSIGN,
+    MINUS_ASSIGN,
+    MULTIPLY_ASSIGN,
+    DIVIDE_ASSIGN,
+    MODULO_ASSIGN,
+    INCREMENT,
+    DECREMENT,
     EQUAL,
     NOT_EQUAL,
     LESS_THAN,
@@ -42,10 +55,20 @@ enum class TokenType {
     LOGICAL_AND,
     LOGICAL_OR,
     LOGICAL_NOT,
+    BIT_AND,
+    BIT_OR,
+    BIT_XOR,
+    BIT_NOT,
+    SHIFT_LEFT,
+    SHIFT_RIGHT,
+    SHIFT_RIGHT_UNSIGNED,
+    INT_DIVIDE,
     
     // Punctuation
     SEMICOLON,
     COMMA,
+    COLON,
+    QUESTION,
     DOT,
     LEFT_PAREN,
     RIGHT_PAREN,
@@ -53,6 +76,7 @@ enum class TokenType {
     RIGHT_BRACE,
     LEFT_BRACKET,
     RIGHT_BRACKET,
+    AT,
     
     // Special
     END_OF_FILE,
@@ -40,21 +40,30 @@ private:
     std::unique_ptr<Statement> parseIfStatement();
     std::unique_ptr<Statement> parseWhileStatement();
     std::unique_ptr<Statement> parseForStatement();
+    std::unique_ptr<Statement> parseAnnotatedLoop();
+    std::unique_ptr<Statement> parseSwitchStatement();
     std::unique_ptr<Statement> parseReturnStatement();
+    std::unique_ptr<Statement> parseLoopJump();
     std::unique_ptr<Statement> parseBlockStatement();
     std::unique_ptr<Statement> parseExpressionStatement();
     
     std::unique_ptr<Expression> parseExpression();
     std::unique_ptr<Expression> parseAssignment();
+    std::unique_ptr<Expression> parseConditional();
     std::unique_ptr<Expression> parseLogicalOr();
     std::unique_ptr<Expression> parseLogicalAnd();
+    std::unique_ptr<Expression> parseBitwiseOr();
+    std::unique_ptr<Expression> parseBitwiseXor();
+    std::unique_ptr<Expression> parseBitwiseAnd();
     std::unique_ptr<Expression> parseEquality();
     std::unique_ptr<Expression> parseComparison();
+    std::unique_ptr<Expression> parseShift();
     std::unique_ptr<Expression> parseAddition();
     std::unique_ptr<Expression> parseMultiplication();
     std::unique_ptr<Expression> parseUnary();
     std::unique_ptr<Expression> parseCall();
     std::unique_ptr<Expression> parsePrimary();
+    std::unique_ptr<Expression> makeIncrement(std::unique_ptr<Expression> target, const Token& op, bool postfix);
     
 public:
     explicit Parser(const std::vector<Token>& tokens);
@@ -0,0 +1,207 @@
+#include "twinert.h"
+#include "simd.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const size_t HEADER_SLOTS = 2;
+static const size_t HEADER_SIZE = HEADER_SLOTS * sizeof(uint64_t);
+
+// Payloads start on a cache line so vector loads never straddle two lines.
+// The block is over-allocated and the header placed in the 16 bytes just
+// before the aligned payload; going through malloc/calloc rather than an
+// aligned allocator keeps calloc's lazily zeroed pages for big arrays.
+static uint64_t* allocAligned(size_t payload, bool zeroed) {
+    size_t size = HEADER_SIZE + payload + TWINE_ARRAY_ALIGNMENT;
+    char* raw = (char*)(zeroed ? calloc(1, size) : malloc(size));
+    uintptr_t data = (uintptr_t)raw + HEADER_SIZE + TWINE_ARRAY_ALIGNMENT - 1;
+    data &= ~(uintptr_t)(TWINE_ARRAY_ALIGNMENT - 1);
+    return (uint64_t*)(data - HEADER_SIZE);
+}
+
+static void writeHeader(uint64_t* block, size_t count, uint32_t elementType) {
+    block[0] = elementType;
+    double countSlot = (double)count;
+    memcpy(block + 1, &countSlot, sizeof(countSlot));
+}
+
+double* twine_array_alloc(size_t count) {
+    uint64_t* block = allocAligned(count * sizeof(double), false);
+    writeHeader(block, count, TWINE_ELEMENT_F64);
+    return (double*)(block + HEADER_SLOTS);
+}
+
+void* twine_typed_array_alloc(size_t count, uint32_t elementType) {
+    // Zeroed, so large typed arrays only touch the pages they use
+    uint64_t* block = allocAligned(twine_array_payload_size(count, elementType), true);
+    writeHeader(block, count, elementType);
+    return block + HEADER_SLOTS;
+}
+
+double twine_array_get(const void* array, double index) {
+    size_t i = (size_t)index;
+    switch (twine_array_type(array)) {
+        case TWINE_ELEMENT_F32: return ((const float*)array)[i];
+        case TWINE_ELEMENT_I32: return ((const int32_t*)array)[i];
+        case TWINE_ELEMENT_I64: return (double)((const int64_t*)array)[i];
+        case TWINE_ELEMENT_BIT: return (((const uint8_t*)array)[i >> 3] >> (i & 7)) & 1;
+        default: return ((const double*)array)[i];
+    }
+}
+
+double twine_array_set(void* array, double index, double value) {
+    size_t i = (size_t)index;
+    switch (twine_array_type(array)) {
+        case TWINE_ELEMENT_F32: ((float*)array)[i] = (float)value; break;
+        case TWINE_ELEMENT_I32: ((int32_t*)array)[i] = (int32_t)value; break;
+        case TWINE_ELEMENT_I64: ((int64_t*)array)[i] = (int64_t)value; break;
+        case TWINE_ELEMENT_BIT: {
+            uint8_t mask = (uint8_t)(1u << (i & 7));
+            uint8_t* byte = (uint8_t*)array + (i >> 3);
+            *byte = value != 0.0 ? (uint8_t)(*byte | mask) : (uint8_t)(*byte & ~mask);
+            break;
+        }
+        default: ((double*)array)[i] = value; break;
+    }
+    return value;
+}
+
+void* twine_array_fill(void* array, double value) {
+    size_t count = twine_array_count(array);
+    switch (twine_array_type(array)) {
+        case TWINE_ELEMENT_F32: {
+            float element = (float)value;
+            for (size_t i = 0; i < count; i++) ((float*)array)[i] = element;
+            break;
+        }
+        case TWINE_ELEMENT_I32: {
+            int32_t element = (int32_t)value;
+            for (size_t i = 0; i < count; i++) ((int32_t*)array)[i] = element;
+            break;
+        }
+        case TWINE_ELEMENT_I64: {
+            int64_t element = (int64_t)value;
+            for (size_t i = 0; i < count; i++) ((int64_t*)array)[i] = element;
+            break;
+        }
+        case TWINE_ELEMENT_BIT: {
+            // Whole bytes at once; bits past the end are kept clear
+            memset(array, value != 0.0 ? 0xFF : 0x00, count / 8);
+            if (count % 8) {
+                ((uint8_t*)array)[count / 8] = value != 0.0 ? (uint8_t)((1u << (count % 8)) - 1) : 0;
+            }
+            break;
+        }
+        default:
+            for (size_t i = 0; i < count; i++) ((double*)array)[i] = value;
+            break;
+    }
+    return array;
+}
+
+void twine_array_load_f64(double* dst, const void* array, size_t from, size_t count) {
+    switch (twine_array_type(array)) {
+        case TWINE_ELEMENT_F32:
+            for (size_t i = 0; i < count; i++) dst[i] = ((const float*)array)[from + i];
+            break;
+        case TWINE_ELEMENT_I32:
+            for (size_t i = 0; i < count; i++) dst[i] = ((const int32_t*)array)[from + i];
+            break;
+        case TWINE_ELEMENT_I64:
+            for (size_t i = 0; i < count; i++) dst[i] = (double)((const int64_t*)array)[from + i];
+            break;
+        case TWINE_ELEMENT_BIT:
+            for (size_t i = 0; i < count; i++) dst[i] = twine_array_get(array, (double)(from + i));
+            break;
+        default:
+            memcpy(dst, (const double*)array + from, count * sizeof(double));
+            break;
+    }
+}
+
+double* twine_append(const void* array, double value) {
+    size_t count = twine_array_count(array);
+    double* result = twine_array_alloc(count + 1);
+    twine_array_load_f64(result, array, 0, count);
+    result[count] = value;
+    return result;
+}
+
+double twine_array_includes(const void* array, double value) {
+    TwineF64View view(array);
+    return findDouble(view.values, view.count, value) >= 0 ? 1.0 : 0.0;
+}
+
+double twine_array_index_of(const void* array, double value) {
+    TwineF64View view(array);
+    return (double)findDouble(view.values, view.count, value);
+}
+
+// Whether the 16 bytes before value look like an array header: a known
+// element type and a whole, nonzero count. Neither a malloc chunk header
+// nor an interned string's header (hash, length) reads that way.
+static bool hasArrayHeader(const void* value) {
+    uint64_t type = ((const uint64_t*)value)[-2];
+    double count = ((const double*)value)[-1];
+    return type <= TWINE_ELEMENT_BIT && count >= 1.0 && count <= 9007199254740992.0 &&
+           count == (double)(uint64_t)count;
+}
+
+// Strings start with a printable character; number arrays usually start
+// with a raw double, but a typed array's first element can be printable
+// (an int 65 is "A"), so those are told apart by the header
+static bool isString(const void* value) {
+    unsigned char first = *(const unsigned char*)value;
+    return first >= 32 && first <= 126 && !hasArrayHeader(value);
+}
+
+double twine_len(const void* value) {
+    if (isString(value)) return (double)twine_str_length((const char*)value);
+    return (double)twine_array_count(value);
+}
+
+void* twine_element_at(const void* value, double index) {
+    if (isString(value)) return (void*)twine_char_at((const char*)value, index);
+    return twine_box_number(twine_array_get(value, index));
+}
+
+double* twine_slice(const void* array, double start, double end) {
+    // The element count lives in front of the first element, so a slice
+    // can't share the parent's buffer; it is copied out in one pass
+    size_t count = twine_array_count(array);
+    size_t from = twine_slice_bound(start, count);
+    size_t to = twine_slice_bound(end, count);
+    if (to < from) to = from;
+
+    double* result = twine_array_alloc(to - from);
+    twine_array_load_f64(result, array, from, to - from);
+    return result;
+}
+
+void* twine_array_copy(void* dst, const void* src) {
+    size_t dstCount = twine_array_count(dst);
+    size_t srcCount = twine_array_count(src);
+    size_t count = srcCount < dstCount ? srcCount : dstCount;
+    uint32_t type = twine_array_type(dst);
+
+    if (type == twine_array_type(src) && type != TWINE_ELEMENT_BIT) {
+        // memmove because dst may be src
+        size_t width = type == TWINE_ELEMENT_F32 || type == TWINE_ELEMENT_I32 ? 4 : 8;
+        memmove(dst, src, count * width);
+    } else if (type == TWINE_ELEMENT_F64) {
+        twine_array_load_f64((double*)dst, src, 0, count);
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            twine_array_set(dst, (double)i, twine_array_get(src, (double)i));
+        }
+    }
+    return dst;
+}
+
+double* twine_array_concat(const void* left, const void* right) {
+    size_t leftCount = twine_array_count(left);
+    size_t rightCount = twine_array_count(right);
+    double* result = twine_array_alloc(leftCount + rightCount);
+    twine_array_load_f64(result, left, 0, leftCount);
+    twine_array_load_f64(result + leftCount, right, 0, rightCount);
+    return result;
+}
@@ -0,0 +1,87 @@
+#include "simd.h"
+#include <string.h>
+
+static void byteMapScalar(char* dst, const char* src, size_t length, ByteRangeRule rule) {
+    unsigned char span = (unsigned char)(rule.high - rule.low);
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)src[i];
+        dst[i] = ((unsigned char)(c - rule.low) <= span) ? (char)(c + rule.delta) : (char)c;
+    }
+}
+
+#ifdef TWINE_SIMD_X86
+// Unsigned range test with signed compares: c is in [low, high] exactly when
+// (c - low) ^ 0x80 < (high - low) - 127 as signed bytes. The last partial
+// vector is handled by re-running the kernel on the final full-width window;
+// the overlap is harmless because every output byte depends only on its input.
+
+TWINE_TARGET_SSE2
+static void byteMapSse2(char* dst, const char* src, size_t length, ByteRangeRule rule) {
+    if (length < 16) {
+        byteMapScalar(dst, src, length, rule);
+        return;
+    }
+
+    const __m128i low = _mm_set1_epi8((char)rule.low);
+    const __m128i bias = _mm_set1_epi8((char)0x80);
+    const __m128i limit = _mm_set1_epi8((char)(rule.high - rule.low - 127));
+    const __m128i delta = _mm_set1_epi8(rule.delta);
+
+    size_t i = 0;
+    for (;; i += 16) {
+        if (i + 16 > length) i = length - 16;
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i shifted = _mm_xor_si128(_mm_sub_epi8(bytes, low), bias);
+        __m128i inRange = _mm_cmplt_epi8(shifted, limit);
+        __m128i mapped = _mm_add_epi8(bytes, _mm_and_si128(inRange, delta));
+        _mm_storeu_si128((__m128i*)(dst + i), mapped);
+        if (i + 16 == length) break;
+    }
+}
+
+TWINE_TARGET_AVX2
+static void byteMapAvx2(char* dst, const char* src, size_t length, ByteRangeRule rule) {
+    if (length < 32) {
+        byteMapSse2(dst, src, length, rule);
+        return;
+    }
+
+    const __m256i low = _mm256_set1_epi8((char)rule.low);
+    const __m256i bias = _mm256_set1_epi8((char)0x80);
+    const __m256i limit = _mm256_set1_epi8((char)(rule.high - rule.low - 127));
+    const __m256i delta = _mm256_set1_epi8(rule.delta);
+
+    size_t i = 0;
+    for (;; i += 32) {
+        if (i + 32 > length) i = length - 32;
+        __m256i bytes = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i shifted = _mm256_xor_si256(_mm256_sub_epi8(bytes, low), bias);
+        __m256i inRange = _mm256_cmpgt_epi8(limit, shifted);
+        __m256i mapped = _mm256_add_epi8(bytes, _mm256_and_si256(inRange, delta));
+        _mm256_storeu_si256((__m256i*)(dst + i), mapped);
+        if (i + 32 == length) break;
+    }
+}
+#endif
+
+void byteMap(char* dst, const char* src, size_t length, ByteRangeRule rule) {
+    if (rule.high < rule.low) {
+        memcpy(dst, src, length);
+        return;
+    }
+    if (rule.high - rule.low == 255) {
+        // Full range: the signed-compare limit would overflow
+        byteMapScalar(dst, src, length, rule);
+        return;
+    }
+
+#ifdef TWINE_SIMD_X86
+    static void (*kernel)(char*, const char*, size_t, ByteRangeRule) = nullptr;
+    if (!kernel) {
+        kernel = cpuHasAvx2() ? byteMapAvx2 : byteMapSse2;
+    }
+    kernel(dst, src, length, rule);
+#else
+    byteMapScalar(dst, src, length, rule);
+#endif
+}
@@ -0,0 +1,30 @@
+#include "twinert.h"
+#include "simd.h"
+
+uint32_t twine_cpu_level(void) {
+#ifdef TWINE_SIMD_X86
+    // Called from ifunc resolvers, which can run before constructors
+    __builtin_cpu_init();
+
+    uint32_t level = TWINE_CPU_BASELINE;
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) {
+        level = TWINE_CPU_SSE42;
+    } else {
+        return level;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+        __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2")) {
+        level = TWINE_CPU_AVX2;
+    } else {
+        return level;
+    }
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+        __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq") &&
+        __builtin_cpu_supports("avx512cd")) {
+        level = TWINE_CPU_AVX512;
+    }
+    return level;
+#else
+    return TWINE_CPU_BASELINE;
+#endif
+}
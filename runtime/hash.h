@@ -0,0 +1,46 @@
+#ifndef TWINERT_HASH_H
+#define TWINERT_HASH_H
+
+// Hash functions shared by runtime containers. Not cryptographic: they only
+// need to spread keys well across power-of-two tables.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+static inline uint64_t hashMix(uint64_t x) {
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static inline uint64_t hashBytes(const char* data, size_t length) {
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+    uint64_t h = (uint64_t)length * multiplier;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        h = (h ^ hashMix(word)) * multiplier;
+    }
+    if (i < length) {
+        uint64_t word = 0;
+        memcpy(&word, data + i, length - i);
+        h = (h ^ hashMix(word)) * multiplier;
+    }
+    return hashMix(h);
+}
+
+static inline uint64_t hashNumber(double value) {
+    // -0.0 and 0.0 compare equal, so they must hash equal
+    if (value == 0.0) value = 0.0;
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return hashMix(bits);
+}
+
+#endif // TWINERT_HASH_H
@@ -0,0 +1,148 @@
+#include "twinert.h"
+#include "hash.h"
+#include <stdlib.h>
+#include <string.h>
+
+// String intern table. Interned strings are copied into arena chunks, each
+// prefixed by a header holding the string's hash and length, so equality
+// between two interned strings is a pointer compare and an interned string's
+// length never needs strlen. A pointer into a chunk is not necessarily
+// interned (a suffix view of an interned string points into the middle of
+// one), so the range check is confirmed against the table before the header
+// is trusted.
+
+struct InternHeader {
+    uint64_t hash;
+    uint64_t length;
+};
+
+struct InternChunk {
+    char* begin;
+    char* end;
+    char* next;
+};
+
+static const size_t MinChunkSize = 64 * 1024;
+static const size_t MaxChunks = 64;
+
+static InternChunk chunks[MaxChunks];
+static size_t chunkCount = 0;
+
+static const char** table = nullptr;
+static size_t tableCapacity = 0;
+static size_t tableCount = 0;
+
+static inline const InternHeader* headerOf(const char* str) {
+    return (const InternHeader*)str - 1;
+}
+
+static bool isInterned(const char* str) {
+    for (size_t i = 0; i < chunkCount; i++) {
+        if (str < chunks[i].begin || str >= chunks[i].next) continue;
+        // Interned strings sit 8-byte aligned right after their header, so
+        // only then is the memory before str a header worth reading
+        size_t offset = (size_t)(str - chunks[i].begin);
+        if (offset < sizeof(InternHeader) || offset % 8 != 0) return false;
+        size_t slot = (size_t)headerOf(str)->hash & (tableCapacity - 1);
+        while (const char* existing = table[slot]) {
+            if (existing == str) return true;
+            slot = (slot + 1) & (tableCapacity - 1);
+        }
+        return false;
+    }
+    return false;
+}
+
+static char* arenaAlloc(size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    if (chunkCount == 0 || (size_t)(chunks[chunkCount - 1].end - chunks[chunkCount - 1].next) < size) {
+        if (chunkCount == MaxChunks) return nullptr;
+        // Chunks double in size so a handful of them covers any program
+        size_t chunkSize = MinChunkSize << (chunkCount < 8 ? chunkCount : 8);
+        if (chunkSize < size) chunkSize = size;
+        char* memory = (char*)malloc(chunkSize);
+        chunks[chunkCount] = InternChunk{memory, memory + chunkSize, memory};
+        chunkCount++;
+    }
+    InternChunk& chunk = chunks[chunkCount - 1];
+    char* result = chunk.next;
+    chunk.next += size;
+    return result;
+}
+
+static void growTable() {
+    size_t newCapacity = tableCapacity ? tableCapacity * 2 : 1024;
+    const char** newTable = (const char**)calloc(newCapacity, sizeof(const char*));
+    for (size_t i = 0; i < tableCapacity; i++) {
+        const char* str = table[i];
+        if (!str) continue;
+        size_t slot = (size_t)headerOf(str)->hash & (newCapacity - 1);
+        while (newTable[slot]) slot = (slot + 1) & (newCapacity - 1);
+        newTable[slot] = str;
+    }
+    free(table);
+    table = newTable;
+    tableCapacity = newCapacity;
+}
+
+const char* twine_intern(const char* str) {
+    if (isInterned(str)) return str;
+
+    size_t length = strlen(str);
+    uint64_t hash = hashBytes(str, length);
+
+    if ((tableCount + 1) * 2 > tableCapacity) growTable();
+
+    size_t slot = (size_t)hash & (tableCapacity - 1);
+    while (const char* existing = table[slot]) {
+        const InternHeader* header = headerOf(existing);
+        if (header->hash == hash && header->length == length && memcmp(existing, str, length) == 0) {
+            return existing;
+        }
+        slot = (slot + 1) & (tableCapacity - 1);
+    }
+
+    char* memory = arenaAlloc(sizeof(InternHeader) + length + 1);
+    if (!memory) return str;
+    InternHeader* header = (InternHeader*)memory;
+    header->hash = hash;
+    header->length = length;
+    char* copy = memory + sizeof(InternHeader);
+    memcpy(copy, str, length + 1);
+
+    table[slot] = copy;
+    tableCount++;
+    return copy;
+}
+
+uint64_t twine_str_hash(const char* str) {
+    // Interned strings already carry their hash
+    if (isInterned(str)) return headerOf(str)->hash;
+    return hashBytes(str, strlen(str));
+}
+
+size_t twine_str_length(const char* str) {
+    return isInterned(str) ? headerOf(str)->length : strlen(str);
+}
+
+int twine_str_eq(const char* left, const char* right) {
+    if (left == right) return 1;
+    if (!left || !right) return 0;
+
+    // Values of unknown kind (function results, map values) may be boxed
+    // numbers, which compare by value and never equal a string
+    bool leftBox = twine_is_box(left);
+    bool rightBox = twine_is_box(right);
+    if (leftBox || rightBox) {
+        return leftBox && rightBox && ((const TwineBox*)left)->value == ((const TwineBox*)right)->value;
+    }
+
+    // Equal interned strings are always the same pointer
+    bool leftInterned = isInterned(left);
+    bool rightInterned = isInterned(right);
+    if (leftInterned && rightInterned) return 0;
+
+    size_t leftLen = leftInterned ? headerOf(left)->length : strlen(left);
+    size_t rightLen = rightInterned ? headerOf(right)->length : strlen(right);
+    return leftLen == rightLen && memcmp(left, right, leftLen) == 0;
+}
@@ -0,0 +1,114 @@
+#include "twinert.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Binary array files written by saveArray() and read by loadArray():
+//   [0]  u64 magic "TWNARRAY"   [8]  u32 element type (TwineElementType)
+//   [12] u32 format version     [16] u64 element count
+//   [48] u64 element type       [56] f64 element count
+//   [64] raw elements
+// The last two header words mirror the in-memory header that sits in front
+// of every array, so a mapped file can be used as an array in place; the
+// mapping is page aligned, so the elements start on a cache line like any
+// other array.
+static const uint64_t ARRAY_FILE_MAGIC = 0x59415252414E5754ULL;
+static const uint32_t ARRAY_FILE_VERSION = 1;
+static const size_t ARRAY_FILE_HEADER_SIZE = 64;
+
+struct ArrayFileHeader {
+    uint64_t magic;
+    uint32_t elementType;
+    uint32_t version;
+    uint64_t count;
+    uint64_t reserved[3];
+    uint64_t typeSlot;
+    double countSlot;
+};
+
+static const size_t INPUT_BUFFER_SIZE = 1024;
+
+char* twine_input(void) {
+    char* buffer = (char*)malloc(INPUT_BUFFER_SIZE);
+    if (!fgets(buffer, (int)INPUT_BUFFER_SIZE, stdin)) {
+        buffer[0] = '\0';
+        return buffer;
+    }
+
+    size_t length = strlen(buffer);
+    if (length > 0 && buffer[length - 1] == '\n') {
+        buffer[length - 1] = '\0';
+    }
+    return buffer;
+}
+
+double twine_save_array(const char* path, const double* array) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return 0.0;
+
+    ArrayFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = ARRAY_FILE_MAGIC;
+    header.elementType = twine_array_type(array);
+    header.version = ARRAY_FILE_VERSION;
+    header.count = twine_array_count(array);
+    header.typeSlot = header.elementType;
+    header.countSlot = (double)header.count;
+
+    size_t payload = twine_array_payload_size((size_t)header.count, header.elementType);
+    fwrite(&header, 1, sizeof(header), file);
+    size_t written = fwrite(array, 1, payload, file);
+    fclose(file);
+    return written == payload ? 1.0 : 0.0;
+}
+
+double* twine_load_array(const char* path) {
+#ifdef _WIN32
+    // No mmap here: read the payload into a freshly allocated array
+    FILE* file = fopen(path, "rb");
+    if (!file) return twine_array_alloc(0);
+
+    ArrayFileHeader header;
+    if (fread(&header, 1, sizeof(header), file) != sizeof(header) || header.magic != ARRAY_FILE_MAGIC ||
+        header.typeSlot != header.elementType) {
+        fclose(file);
+        return twine_array_alloc(0);
+    }
+
+    size_t payload = twine_array_payload_size((size_t)header.count, header.elementType);
+    void* data = twine_typed_array_alloc((size_t)header.count, header.elementType);
+    fread(data, 1, payload, file);
+    fclose(file);
+    return (double*)data;
+#else
+    // Map the file privately: pages are shared with the page cache and only
+    // copied if the program writes to the array, and never written back.
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return twine_array_alloc(0);
+
+    off_t fileSize = lseek(fd, 0, SEEK_END);
+    if (fileSize < (off_t)ARRAY_FILE_HEADER_SIZE) {
+        close(fd);
+        return twine_array_alloc(0);
+    }
+
+    void* base = mmap(NULL, (size_t)fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return twine_array_alloc(0);
+
+    const ArrayFileHeader* header = (const ArrayFileHeader*)base;
+    if (header->magic != ARRAY_FILE_MAGIC || header->typeSlot != header->elementType ||
+        (uint64_t)fileSize < ARRAY_FILE_HEADER_SIZE +
+            twine_array_payload_size((size_t)header->count, header->elementType)) {
+        munmap(base, (size_t)fileSize);
+        return twine_array_alloc(0);
+    }
+    return (double*)((char*)base + ARRAY_FILE_HEADER_SIZE);
+#endif
+}
@@ -0,0 +1,315 @@
+#include "twinert.h"
+#include "simd.h"
+#include "hash.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Hash map with SwissTable-style open addressing. Each slot has a control
+// byte: EMPTY, DELETED, or the low 7 bits of the key's hash (H2) when full.
+// A lookup loads a 16-byte group of control bytes, compares all of them
+// against H2 at once and only inspects slots whose byte matched. Entries are
+// kept in a separate insertion-ordered array that slots index into, so
+// iteration is dense and rehashing never moves keys or values.
+
+static const int8_t CtrlEmpty = -128;
+static const int8_t CtrlDeleted = -2;
+static const size_t GroupWidth = 16;
+
+struct MapEntry {
+    uint64_t hash;          // cached so lookups and rehashes never re-hash the key
+    char* stringKey;        // owned copy, or null for numeric keys
+    size_t stringLength;
+    double numberKey;
+    void* value;            // boxed value (set() may store null)
+    bool deleted;
+};
+
+struct TwineMap {
+    int8_t* ctrl;
+    uint32_t* slots;        // entry index for each full slot
+    size_t capacity;        // power of two, multiple of GroupWidth
+    size_t used;            // full + deleted slots; bounds probe sequences
+    MapEntry* entries;
+    size_t entryCount;      // including deleted entries
+    size_t entryCapacity;
+    size_t liveCount;
+};
+
+struct MapKey {
+    uint64_t hash;
+    const char* string;
+    size_t length;
+    double number;
+};
+
+static MapKey stringKey(const char* key) {
+    size_t length = strlen(key);
+    return MapKey{hashBytes(key, length), key, length, 0.0};
+}
+
+static MapKey numberKey(double key) {
+    return MapKey{hashNumber(key), nullptr, 0, key};
+}
+
+// A key whose kind wasn't known at compile time: boxed numbers (function
+// results, get() values) are numeric keys, anything else is a string
+static MapKey anyKey(const void* key) {
+    if (twine_is_box(key)) return numberKey(((const TwineBox*)key)->value);
+    return stringKey((const char*)key);
+}
+
+static inline int8_t hashTag(uint64_t hash) {
+    return (int8_t)(hash & 0x7F);
+}
+
+static inline bool keyMatches(const MapEntry& entry, const MapKey& key) {
+    if (entry.hash != key.hash || entry.deleted) return false;
+    if (key.string) {
+        return entry.stringKey && entry.stringLength == key.length &&
+               memcmp(entry.stringKey, key.string, key.length) == 0;
+    }
+    // NaN keys match each other so they can be looked up again
+    return !entry.stringKey &&
+           (entry.numberKey == key.number || (entry.numberKey != entry.numberKey && key.number != key.number));
+}
+
+#ifdef TWINE_SIMD_X86
+TWINE_TARGET_SSE2
+static inline uint32_t matchByte(const int8_t* group, int8_t byte) {
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(byte)));
+}
+
+TWINE_TARGET_SSE2
+static inline uint32_t matchEmptyOrDeleted(const int8_t* group) {
+    // EMPTY and DELETED are the only control bytes with the high bit set
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+}
+#else
+static inline uint32_t matchByte(const int8_t* group, int8_t byte) {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < GroupWidth; i++) {
+        if (group[i] == byte) mask |= 1u << i;
+    }
+    return mask;
+}
+
+static inline uint32_t matchEmptyOrDeleted(const int8_t* group) {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < GroupWidth; i++) {
+        if (group[i] < 0) mask |= 1u << i;
+    }
+    return mask;
+}
+#endif
+
+// Returns the slot holding key, or -1. Groups are probed triangularly, which
+// visits every group of a power-of-two table.
+static ptrdiff_t findSlot(const TwineMap* map, const MapKey& key) {
+    size_t groupMask = map->capacity / GroupWidth - 1;
+    size_t group = (size_t)(key.hash >> 7) & groupMask;
+    int8_t tag = hashTag(key.hash);
+    for (size_t step = 1;; step++) {
+        const int8_t* ctrl = map->ctrl + group * GroupWidth;
+        uint32_t mask = matchByte(ctrl, tag);
+        while (mask) {
+            size_t slot = group * GroupWidth + (size_t)__builtin_ctz(mask);
+            if (keyMatches(map->entries[map->slots[slot]], key)) return (ptrdiff_t)slot;
+            mask &= mask - 1;
+        }
+        if (matchByte(ctrl, CtrlEmpty)) return -1;
+        group = (group + step) & groupMask;
+    }
+}
+
+static size_t findInsertSlot(const TwineMap* map, uint64_t hash) {
+    size_t groupMask = map->capacity / GroupWidth - 1;
+    size_t group = (size_t)(hash >> 7) & groupMask;
+    for (size_t step = 1;; step++) {
+        uint32_t mask = matchEmptyOrDeleted(map->ctrl + group * GroupWidth);
+        if (mask) return group * GroupWidth + (size_t)__builtin_ctz(mask);
+        group = (group + step) & groupMask;
+    }
+}
+
+// Rebuilds the slot table at newCapacity and drops deleted entries, keeping
+// the remaining ones in insertion order.
+static void rehash(TwineMap* map, size_t newCapacity) {
+    size_t live = 0;
+    for (size_t i = 0; i < map->entryCount; i++) {
+        if (!map->entries[i].deleted) {
+            map->entries[live++] = map->entries[i];
+        } else {
+            free(map->entries[i].stringKey);
+        }
+    }
+    map->entryCount = live;
+
+    free(map->ctrl);
+    free(map->slots);
+    map->capacity = newCapacity;
+    map->ctrl = (int8_t*)malloc(newCapacity);
+    map->slots = (uint32_t*)malloc(newCapacity * sizeof(uint32_t));
+    memset(map->ctrl, CtrlEmpty, newCapacity);
+
+    for (size_t i = 0; i < live; i++) {
+        size_t slot = findInsertSlot(map, map->entries[i].hash);
+        map->ctrl[slot] = hashTag(map->entries[i].hash);
+        map->slots[slot] = (uint32_t)i;
+    }
+    map->used = live;
+}
+
+static void compact(TwineMap* map) {
+    if (map->entryCount != map->liveCount) rehash(map, map->capacity);
+}
+
+static void insert(TwineMap* map, const MapKey& key, void* value) {
+    ptrdiff_t existing = findSlot(map, key);
+    if (existing >= 0) {
+        map->entries[map->slots[existing]].value = value;
+        return;
+    }
+
+    // Keep at most 7/8 of the slots full or deleted
+    if ((map->used + 1) * 8 > map->capacity * 7) {
+        size_t newCapacity = map->capacity;
+        while ((map->liveCount + 1) * 2 > newCapacity) newCapacity *= 2;
+        rehash(map, newCapacity);
+    }
+
+    if (map->entryCount == map->entryCapacity) {
+        map->entryCapacity *= 2;
+        map->entries = (MapEntry*)realloc(map->entries, map->entryCapacity * sizeof(MapEntry));
+    }
+
+    MapEntry& entry = map->entries[map->entryCount];
+    entry.hash = key.hash;
+    entry.stringKey = nullptr;
+    entry.stringLength = key.length;
+    entry.numberKey = key.number;
+    entry.value = value;
+    entry.deleted = false;
+    if (key.string) {
+        entry.stringKey = (char*)malloc(key.length + 1);
+        memcpy(entry.stringKey, key.string, key.length + 1);
+    }
+
+    size_t slot = findInsertSlot(map, key.hash);
+    if (map->ctrl[slot] == CtrlEmpty) map->used++;
+    map->ctrl[slot] = hashTag(key.hash);
+    map->slots[slot] = (uint32_t)map->entryCount;
+    map->entryCount++;
+    map->liveCount++;
+}
+
+static void* lookup(TwineMap* map, const MapKey& key, void* fallback) {
+    static TwineBox zero = {TWINE_BOX_TAG, 0.0};
+    ptrdiff_t slot = findSlot(map, key);
+    if (slot >= 0) return map->entries[map->slots[slot]].value;
+    return fallback ? fallback : &zero;
+}
+
+static double erase(TwineMap* map, const MapKey& key) {
+    ptrdiff_t slot = findSlot(map, key);
+    if (slot < 0) return 0.0;
+    map->entries[map->slots[slot]].deleted = true;
+    map->entries[map->slots[slot]].value = nullptr;
+    map->ctrl[slot] = CtrlDeleted;
+    map->liveCount--;
+    return 1.0;
+}
+
+void* twine_map_new(void) {
+    TwineMap* map = (TwineMap*)malloc(sizeof(TwineMap));
+    map->capacity = GroupWidth;
+    map->ctrl = (int8_t*)malloc(map->capacity);
+    map->slots = (uint32_t*)malloc(map->capacity * sizeof(uint32_t));
+    memset(map->ctrl, CtrlEmpty, map->capacity);
+    map->used = 0;
+    map->entryCapacity = 8;
+    map->entries = (MapEntry*)malloc(map->entryCapacity * sizeof(MapEntry));
+    map->entryCount = 0;
+    map->liveCount = 0;
+    return map;
+}
+
+void* twine_map_set_num(void* map, double key, void* value) {
+    insert((TwineMap*)map, numberKey(key), value);
+    return map;
+}
+
+void* twine_map_set_str(void* map, const char* key, void* value) {
+    insert((TwineMap*)map, stringKey(key), value);
+    return map;
+}
+
+void* twine_map_set_any(void* map, const void* key, void* value) {
+    insert((TwineMap*)map, anyKey(key), value);
+    return map;
+}
+
+void* twine_map_get_num(void* map, double key, void* fallback) {
+    return lookup((TwineMap*)map, numberKey(key), fallback);
+}
+
+void* twine_map_get_str(void* map, const char* key, void* fallback) {
+    return lookup((TwineMap*)map, stringKey(key), fallback);
+}
+
+void* twine_map_get_any(void* map, const void* key, void* fallback) {
+    return lookup((TwineMap*)map, anyKey(key), fallback);
+}
+
+double twine_map_has_num(void* map, double key) {
+    return findSlot((TwineMap*)map, numberKey(key)) >= 0 ? 1.0 : 0.0;
+}
+
+double twine_map_has_str(void* map, const char* key) {
+    return findSlot((TwineMap*)map, stringKey(key)) >= 0 ? 1.0 : 0.0;
+}
+
+double twine_map_has_any(void* map, const void* key) {
+    return findSlot((TwineMap*)map, anyKey(key)) >= 0 ? 1.0 : 0.0;
+}
+
+double twine_map_delete_num(void* map, double key) {
+    return erase((TwineMap*)map, numberKey(key));
+}
+
+double twine_map_delete_str(void* map, const char* key) {
+    return erase((TwineMap*)map, stringKey(key));
+}
+
+double twine_map_delete_any(void* map, const void* key) {
+    return erase((TwineMap*)map, anyKey(key));
+}
+
+double twine_map_size(void* map) {
+    return (double)((TwineMap*)map)->liveCount;
+}
+
+double* twine_map_keys(void* map) {
+    TwineMap* m = (TwineMap*)map;
+    compact(m);
+    size_t count = 0;
+    for (size_t i = 0; i < m->entryCount; i++) {
+        if (!m->entries[i].stringKey) count++;
+    }
+    double* keys = twine_array_alloc(count);
+    size_t next = 0;
+    for (size_t i = 0; i < m->entryCount; i++) {
+        if (!m->entries[i].stringKey) keys[next++] = m->entries[i].numberKey;
+    }
+    return keys;
+}
+
+void* twine_map_key_at(void* map, double index) {
+    TwineMap* m = (TwineMap*)map;
+    compact(m);
+    size_t i = (size_t)index;
+    if (index < 0 || i >= m->entryCount) return (void*)"";
+    const MapEntry& entry = m->entries[i];
+    if (entry.stringKey) return entry.stringKey;
+    return twine_box_number(entry.numberKey);
+}
@@ -0,0 +1,20 @@
+#include "twinert.h"
+#include <time.h>
+
+static uint64_t randomState = 1;
+static int randomSeeded = 0;
+
+double twine_random(void) {
+    if (!randomSeeded) {
+        // Mix the clock with a stack address so runs started in the same second differ
+        volatile int entropy = 0;
+        uint64_t stackAddr = (uint64_t)(uintptr_t)&entropy;
+        uint64_t seed = (uint64_t)time(NULL) * 1103515245ULL + stackAddr * 12345ULL + 1;
+        randomState = seed ^ (stackAddr >> 16);
+        randomSeeded = 1;
+    }
+
+    randomState = randomState * 1664525ULL + 1013904223ULL;
+    uint32_t upperBits = (uint32_t)(randomState >> 32);
+    return (double)upperBits / 4294967296.0;
+}
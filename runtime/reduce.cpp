@@ -0,0 +1,302 @@
+#include "twinert.h"
+#include "simd.h"
+#include <math.h>
+
+// Reduction kernels. Each one keeps several independent accumulators so
+// consecutive additions don't wait on each other, which also means results
+// can differ from a left-to-right loop in the last few bits.
+
+struct ReduceKernels {
+    double (*sum)(const double*, size_t);
+    double (*prod)(const double*, size_t);
+    double (*min)(const double*, size_t);
+    double (*max)(const double*, size_t);
+    double (*dot)(const double*, const double*, size_t);
+    double (*squaredDeviations)(const double*, size_t, double);
+};
+
+static double sumScalar(const double* values, size_t count) {
+    double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        s0 += values[i];
+        s1 += values[i + 1];
+        s2 += values[i + 2];
+        s3 += values[i + 3];
+    }
+    for (; i < count; i++) s0 += values[i];
+    return (s0 + s1) + (s2 + s3);
+}
+
+static double prodScalar(const double* values, size_t count) {
+    double p0 = 1.0, p1 = 1.0, p2 = 1.0, p3 = 1.0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        p0 *= values[i];
+        p1 *= values[i + 1];
+        p2 *= values[i + 2];
+        p3 *= values[i + 3];
+    }
+    for (; i < count; i++) p0 *= values[i];
+    return (p0 * p1) * (p2 * p3);
+}
+
+static double minScalar(const double* values, size_t count) {
+    double m = values[0];
+    for (size_t i = 1; i < count; i++) {
+        if (values[i] < m) m = values[i];
+    }
+    return m;
+}
+
+static double maxScalar(const double* values, size_t count) {
+    double m = values[0];
+    for (size_t i = 1; i < count; i++) {
+        if (values[i] > m) m = values[i];
+    }
+    return m;
+}
+
+static double dotScalar(const double* a, const double* b, size_t count) {
+    double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < count; i++) s0 += a[i] * b[i];
+    return (s0 + s1) + (s2 + s3);
+}
+
+static double squaredDeviationsScalar(const double* values, size_t count, double mean) {
+    double s0 = 0.0, s1 = 0.0;
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        double d0 = values[i] - mean;
+        double d1 = values[i + 1] - mean;
+        s0 += d0 * d0;
+        s1 += d1 * d1;
+    }
+    for (; i < count; i++) {
+        double d = values[i] - mean;
+        s0 += d * d;
+    }
+    return s0 + s1;
+}
+
+#ifdef TWINE_SIMD_X86
+// AVX2 kernels use four 4-lane accumulators (16 elements per iteration) and
+// finish the remainder with the scalar kernel.
+
+TWINE_TARGET_AVX2
+static inline double horizontalSum(__m256d v) {
+    __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+TWINE_TARGET_AVX2
+static inline double horizontalProd(__m256d v) {
+    __m128d pair = _mm_mul_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_mul_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+TWINE_TARGET_AVX2
+static double sumAvx2(const double* values, size_t count) {
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    __m256d acc2 = _mm256_setzero_pd(), acc3 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(values + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(values + i + 4));
+        acc2 = _mm256_add_pd(acc2, _mm256_loadu_pd(values + i + 8));
+        acc3 = _mm256_add_pd(acc3, _mm256_loadu_pd(values + i + 12));
+    }
+    __m256d acc = _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3));
+    return horizontalSum(acc) + sumScalar(values + i, count - i);
+}
+
+TWINE_TARGET_AVX2
+static double prodAvx2(const double* values, size_t count) {
+    const __m256d one = _mm256_set1_pd(1.0);
+    __m256d acc0 = one, acc1 = one, acc2 = one, acc3 = one;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        acc0 = _mm256_mul_pd(acc0, _mm256_loadu_pd(values + i));
+        acc1 = _mm256_mul_pd(acc1, _mm256_loadu_pd(values + i + 4));
+        acc2 = _mm256_mul_pd(acc2, _mm256_loadu_pd(values + i + 8));
+        acc3 = _mm256_mul_pd(acc3, _mm256_loadu_pd(values + i + 12));
+    }
+    __m256d acc = _mm256_mul_pd(_mm256_mul_pd(acc0, acc1), _mm256_mul_pd(acc2, acc3));
+    return horizontalProd(acc) * prodScalar(values + i, count - i);
+}
+
+TWINE_TARGET_AVX2
+static double minAvx2(const double* values, size_t count) {
+    if (count < 16) return minScalar(values, count);
+    __m256d acc0 = _mm256_loadu_pd(values), acc1 = _mm256_loadu_pd(values + 4);
+    __m256d acc2 = _mm256_loadu_pd(values + 8), acc3 = _mm256_loadu_pd(values + 12);
+    size_t i = 16;
+    for (; i + 16 <= count; i += 16) {
+        acc0 = _mm256_min_pd(acc0, _mm256_loadu_pd(values + i));
+        acc1 = _mm256_min_pd(acc1, _mm256_loadu_pd(values + i + 4));
+        acc2 = _mm256_min_pd(acc2, _mm256_loadu_pd(values + i + 8));
+        acc3 = _mm256_min_pd(acc3, _mm256_loadu_pd(values + i + 12));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_min_pd(_mm256_min_pd(acc0, acc1), _mm256_min_pd(acc2, acc3)));
+    double m = minScalar(lanes, 4);
+    for (; i < count; i++) {
+        if (values[i] < m) m = values[i];
+    }
+    return m;
+}
+
+TWINE_TARGET_AVX2
+static double maxAvx2(const double* values, size_t count) {
+    if (count < 16) return maxScalar(values, count);
+    __m256d acc0 = _mm256_loadu_pd(values), acc1 = _mm256_loadu_pd(values + 4);
+    __m256d acc2 = _mm256_loadu_pd(values + 8), acc3 = _mm256_loadu_pd(values + 12);
+    size_t i = 16;
+    for (; i + 16 <= count; i += 16) {
+        acc0 = _mm256_max_pd(acc0, _mm256_loadu_pd(values + i));
+        acc1 = _mm256_max_pd(acc1, _mm256_loadu_pd(values + i + 4));
+        acc2 = _mm256_max_pd(acc2, _mm256_loadu_pd(values + i + 8));
+        acc3 = _mm256_max_pd(acc3, _mm256_loadu_pd(values + i + 12));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_max_pd(_mm256_max_pd(acc0, acc1), _mm256_max_pd(acc2, acc3)));
+    double m = maxScalar(lanes, 4);
+    for (; i < count; i++) {
+        if (values[i] > m) m = values[i];
+    }
+    return m;
+}
+
+TWINE_TARGET_AVX2
+static double dotAvx2(const double* a, const double* b, size_t count) {
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    __m256d acc2 = _mm256_setzero_pd(), acc3 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+        acc2 = _mm256_add_pd(acc2, _mm256_mul_pd(_mm256_loadu_pd(a + i + 8), _mm256_loadu_pd(b + i + 8)));
+        acc3 = _mm256_add_pd(acc3, _mm256_mul_pd(_mm256_loadu_pd(a + i + 12), _mm256_loadu_pd(b + i + 12)));
+    }
+    __m256d acc = _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3));
+    return horizontalSum(acc) + dotScalar(a + i, b + i, count - i);
+}
+
+TWINE_TARGET_AVX2
+static double squaredDeviationsAvx2(const double* values, size_t count, double mean) {
+    const __m256d center = _mm256_set1_pd(mean);
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    __m256d acc2 = _mm256_setzero_pd(), acc3 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(values + i), center);
+        __m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(values + i + 4), center);
+        __m256d d2 = _mm256_sub_pd(_mm256_loadu_pd(values + i + 8), center);
+        __m256d d3 = _mm256_sub_pd(_mm256_loadu_pd(values + i + 12), center);
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(d0, d0));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(d1, d1));
+        acc2 = _mm256_add_pd(acc2, _mm256_mul_pd(d2, d2));
+        acc3 = _mm256_add_pd(acc3, _mm256_mul_pd(d3, d3));
+    }
+    __m256d acc = _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3));
+    return horizontalSum(acc) + squaredDeviationsScalar(values + i, count - i, mean);
+}
+#endif
+
+static const ReduceKernels& kernels() {
+    static const ReduceKernels scalar = {
+        sumScalar, prodScalar, minScalar, maxScalar, dotScalar, squaredDeviationsScalar
+    };
+#ifdef TWINE_SIMD_X86
+    static const ReduceKernels avx2 = {
+        sumAvx2, prodAvx2, minAvx2, maxAvx2, dotAvx2, squaredDeviationsAvx2
+    };
+    static const ReduceKernels* selected = nullptr;
+    if (!selected) {
+        selected = cpuHasAvx2() ? &avx2 : &scalar;
+    }
+    return *selected;
+#else
+    return scalar;
+#endif
+}
+
+// Stable mode: split the input in halves until blocks are small, reduce each
+// block with the fast kernel, and add the partial sums back up as a tree.
+static const size_t PairwiseBlock = 256;
+
+static double pairwiseSum(const double* values, size_t count) {
+    if (count <= PairwiseBlock) return kernels().sum(values, count);
+    size_t half = count / 2;
+    return pairwiseSum(values, half) + pairwiseSum(values + half, count - half);
+}
+
+static double pairwiseDot(const double* a, const double* b, size_t count) {
+    if (count <= PairwiseBlock) return kernels().dot(a, b, count);
+    size_t half = count / 2;
+    return pairwiseDot(a, b, half) + pairwiseDot(a + half, b + half, count - half);
+}
+
+static double pairwiseSquaredDeviations(const double* values, size_t count, double mean) {
+    if (count <= PairwiseBlock) return kernels().squaredDeviations(values, count, mean);
+    size_t half = count / 2;
+    return pairwiseSquaredDeviations(values, half, mean) +
+           pairwiseSquaredDeviations(values + half, count - half, mean);
+}
+
+static double sumValues(const double* values, size_t count, double stable) {
+    return stable != 0.0 ? pairwiseSum(values, count) : kernels().sum(values, count);
+}
+
+// The entry points read arrays through a TwineF64View, so typed arrays are
+// widened once and then share the number-array kernels
+double twine_sum(const void* array, double stable) {
+    TwineF64View view(array);
+    return sumValues(view.values, view.count, stable);
+}
+
+double twine_prod(const void* array) {
+    TwineF64View view(array);
+    return kernels().prod(view.values, view.count);
+}
+
+double twine_min_of(const void* array) {
+    TwineF64View view(array);
+    return view.count ? kernels().min(view.values, view.count) : NAN;
+}
+
+double twine_max_of(const void* array) {
+    TwineF64View view(array);
+    return view.count ? kernels().max(view.values, view.count) : NAN;
+}
+
+double twine_mean(const void* array, double stable) {
+    TwineF64View view(array);
+    return view.count ? sumValues(view.values, view.count, stable) / (double)view.count : NAN;
+}
+
+double twine_variance(const void* array, double stable) {
+    // Two passes (mean, then squared deviations) avoid the cancellation of
+    // the one-pass sum-of-squares formula
+    TwineF64View view(array);
+    if (!view.count) return NAN;
+    double mean = sumValues(view.values, view.count, stable) / (double)view.count;
+    double deviations = stable != 0.0 ? pairwiseSquaredDeviations(view.values, view.count, mean)
+                                      : kernels().squaredDeviations(view.values, view.count, mean);
+    return deviations / (double)view.count;
+}
+
+double twine_dot(const void* a, const void* b, double stable) {
+    TwineF64View viewA(a);
+    TwineF64View viewB(b);
+    size_t count = viewA.count < viewB.count ? viewA.count : viewB.count;
+    return stable != 0.0 ? pairwiseDot(viewA.values, viewB.values, count)
+                         : kernels().dot(viewA.values, viewB.values, count);
+}
@@ -0,0 +1,135 @@
+#include "simd.h"
+#include <string.h>
+
+static ptrdiff_t findDoubleScalar(const double* values, size_t start, size_t count, double value) {
+    for (size_t i = start; i < count; i++) {
+        if (values[i] == value) return (ptrdiff_t)i;
+    }
+    return -1;
+}
+
+static ptrdiff_t findSubstringScalar(const char* haystack, size_t start, size_t haystackLen,
+                                     const char* needle, size_t needleLen) {
+    for (size_t i = start; i + needleLen <= haystackLen; i++) {
+        if (haystack[i] == needle[0] && memcmp(haystack + i, needle, needleLen) == 0) {
+            return (ptrdiff_t)i;
+        }
+    }
+    return -1;
+}
+
+#ifdef TWINE_SIMD_X86
+// Array membership: compare four vectors per iteration and OR the masks so
+// the loop has a single branch; the exact lane is only located after a hit.
+
+TWINE_TARGET_SSE2
+static ptrdiff_t findDoubleSse2(const double* values, size_t count, double value) {
+    const __m128d needle = _mm_set1_pd(value);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128d eq0 = _mm_cmpeq_pd(_mm_loadu_pd(values + i), needle);
+        __m128d eq1 = _mm_cmpeq_pd(_mm_loadu_pd(values + i + 2), needle);
+        __m128d eq2 = _mm_cmpeq_pd(_mm_loadu_pd(values + i + 4), needle);
+        __m128d eq3 = _mm_cmpeq_pd(_mm_loadu_pd(values + i + 6), needle);
+        __m128d any = _mm_or_pd(_mm_or_pd(eq0, eq1), _mm_or_pd(eq2, eq3));
+        if (_mm_movemask_pd(any)) {
+            return findDoubleScalar(values, i, i + 8, value);
+        }
+    }
+    return findDoubleScalar(values, i, count, value);
+}
+
+TWINE_TARGET_AVX2
+static ptrdiff_t findDoubleAvx2(const double* values, size_t count, double value) {
+    const __m256d needle = _mm256_set1_pd(value);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256d eq0 = _mm256_cmp_pd(_mm256_loadu_pd(values + i), needle, _CMP_EQ_OQ);
+        __m256d eq1 = _mm256_cmp_pd(_mm256_loadu_pd(values + i + 4), needle, _CMP_EQ_OQ);
+        __m256d eq2 = _mm256_cmp_pd(_mm256_loadu_pd(values + i + 8), needle, _CMP_EQ_OQ);
+        __m256d eq3 = _mm256_cmp_pd(_mm256_loadu_pd(values + i + 12), needle, _CMP_EQ_OQ);
+        __m256d any = _mm256_or_pd(_mm256_or_pd(eq0, eq1), _mm256_or_pd(eq2, eq3));
+        if (_mm256_movemask_pd(any)) {
+            return findDoubleScalar(values, i, i + 16, value);
+        }
+    }
+    return findDoubleScalar(values, i, count, value);
+}
+
+// Substring search with a first/last byte filter: each vector step tests 16
+// or 32 candidate positions at once by matching the needle's first byte at
+// i and its last byte at i + needleLen - 1, and only runs memcmp on positions
+// where both match.
+
+TWINE_TARGET_SSE2
+static ptrdiff_t findSubstringSse2(const char* haystack, size_t haystackLen,
+                                   const char* needle, size_t needleLen) {
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needleLen - 1]);
+    size_t i = 0;
+    for (; i + needleLen + 15 <= haystackLen; i += 16) {
+        __m128i blockFirst = _mm_loadu_si128((const __m128i*)(haystack + i));
+        __m128i blockLast = _mm_loadu_si128((const __m128i*)(haystack + i + needleLen - 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last)));
+        while (mask) {
+            unsigned bit = (unsigned)__builtin_ctz(mask);
+            if (memcmp(haystack + i + bit + 1, needle + 1, needleLen - 1) == 0) {
+                return (ptrdiff_t)(i + bit);
+            }
+            mask &= mask - 1;
+        }
+    }
+    return findSubstringScalar(haystack, i, haystackLen, needle, needleLen);
+}
+
+TWINE_TARGET_AVX2
+static ptrdiff_t findSubstringAvx2(const char* haystack, size_t haystackLen,
+                                   const char* needle, size_t needleLen) {
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needleLen - 1]);
+    size_t i = 0;
+    for (; i + needleLen + 31 <= haystackLen; i += 32) {
+        __m256i blockFirst = _mm256_loadu_si256((const __m256i*)(haystack + i));
+        __m256i blockLast = _mm256_loadu_si256((const __m256i*)(haystack + i + needleLen - 1));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last)));
+        while (mask) {
+            unsigned bit = (unsigned)__builtin_ctz(mask);
+            if (memcmp(haystack + i + bit + 1, needle + 1, needleLen - 1) == 0) {
+                return (ptrdiff_t)(i + bit);
+            }
+            mask &= mask - 1;
+        }
+    }
+    return findSubstringScalar(haystack, i, haystackLen, needle, needleLen);
+}
+#endif
+
+ptrdiff_t findDouble(const double* values, size_t count, double value) {
+#ifdef TWINE_SIMD_X86
+    static ptrdiff_t (*kernel)(const double*, size_t, double) = nullptr;
+    if (!kernel) {
+        kernel = cpuHasAvx2() ? findDoubleAvx2 : findDoubleSse2;
+    }
+    return kernel(values, count, value);
+#else
+    return findDoubleScalar(values, 0, count, value);
+#endif
+}
+
+ptrdiff_t findSubstring(const char* haystack, size_t haystackLen,
+                        const char* needle, size_t needleLen) {
+    if (needleLen == 0) return 0;
+    if (needleLen > haystackLen) return -1;
+
+#ifdef TWINE_SIMD_X86
+    static ptrdiff_t (*kernel)(const char*, size_t, const char*, size_t) = nullptr;
+    if (!kernel) {
+        kernel = cpuHasAvx2() ? findSubstringAvx2 : findSubstringSse2;
+    }
+    return kernel(haystack, haystackLen, needle, needleLen);
+#else
+    return findSubstringScalar(haystack, 0, haystackLen, needle, needleLen);
+#endif
+}
@@ -0,0 +1,39 @@
+#ifndef TWINERT_SIMD_H
+#define TWINERT_SIMD_H
+
+// SIMD support for runtime kernels. Kernels are compiled for several ISA
+// levels with target attributes and picked at runtime from the CPU's features,
+// so one libtwinert build runs everywhere and still uses AVX2 where present.
+
+#include <stddef.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TWINE_SIMD_X86 1
+#include <immintrin.h>
+#define TWINE_TARGET_SSE2 __attribute__((target("sse2")))
+#define TWINE_TARGET_AVX2 __attribute__((target("avx2")))
+
+static inline bool cpuHasAvx2() {
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+// Byte-map kernel: bytes in [low, high] are shifted by delta, all others are
+// copied unchanged. upper() and lower() are single rules; other per-byte
+// transforms should be expressed as rules so they share the vector kernels.
+// dst and src must not overlap.
+struct ByteRangeRule {
+    unsigned char low;
+    unsigned char high;
+    signed char delta;
+};
+
+void byteMap(char* dst, const char* src, size_t length, ByteRangeRule rule);
+
+// Search kernels. Both return the index of the first match or -1.
+// findDouble uses ordered equality, so NaN is never found.
+ptrdiff_t findDouble(const double* values, size_t count, double value);
+ptrdiff_t findSubstring(const char* haystack, size_t haystackLen,
+                        const char* needle, size_t needleLen);
+
+#endif // TWINERT_SIMD_H
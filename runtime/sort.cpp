@@ -0,0 +1,326 @@
+#include "twinert.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Numeric sort: pattern-defeating quicksort for small and medium arrays and
+// an LSD radix sort on the IEEE-754 bit pattern for large ones. NaNs are
+// moved to the end first so the comparison sort sees a strict weak order.
+
+static const size_t InsertionSortThreshold = 24;
+static const size_t NintherThreshold = 128;
+static const size_t PartialInsertionSortLimit = 8;
+static const size_t RadixSortThreshold = 1 << 16;
+
+static inline void swapValues(double* a, double* b) {
+    double tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+static inline void sort2(double* a, double* b) {
+    if (*b < *a) swapValues(a, b);
+}
+
+static inline void sort3(double* a, double* b, double* c) {
+    sort2(a, b);
+    sort2(b, c);
+    sort2(a, b);
+}
+
+static void insertionSort(double* begin, double* end) {
+    for (double* cur = begin + 1; cur < end; cur++) {
+        double value = *cur;
+        double* hole = cur;
+        while (hole > begin && value < hole[-1]) {
+            *hole = hole[-1];
+            hole--;
+        }
+        *hole = value;
+    }
+}
+
+// Insertion sort that gives up after a few element moves; used to finish
+// inputs that partitioning suggests are already (nearly) sorted.
+static bool partialInsertionSort(double* begin, double* end) {
+    size_t moves = 0;
+    for (double* cur = begin + 1; cur < end; cur++) {
+        double value = *cur;
+        double* hole = cur;
+        while (hole > begin && value < hole[-1]) {
+            *hole = hole[-1];
+            hole--;
+        }
+        *hole = value;
+        moves += (size_t)(cur - hole);
+        if (moves > PartialInsertionSortLimit) return false;
+    }
+    return true;
+}
+
+static void siftDown(double* heap, size_t count, size_t root) {
+    double value = heap[root];
+    for (;;) {
+        size_t child = 2 * root + 1;
+        if (child >= count) break;
+        if (child + 1 < count && heap[child] < heap[child + 1]) child++;
+        if (!(value < heap[child])) break;
+        heap[root] = heap[child];
+        root = child;
+    }
+    heap[root] = value;
+}
+
+static void heapSort(double* begin, double* end) {
+    size_t count = (size_t)(end - begin);
+    for (size_t i = count / 2; i-- > 0;) siftDown(begin, count, i);
+    for (size_t i = count; i-- > 1;) {
+        swapValues(begin, begin + i);
+        siftDown(begin, i, 0);
+    }
+}
+
+// Partitions [begin, end) around *begin into [< pivot] pivot [>= pivot] and
+// returns the pivot's final position. Median-of-3 selection guarantees both
+// scans hit a sentinel. alreadyPartitioned is set when no swaps were needed.
+static double* partitionRight(double* begin, double* end, bool& alreadyPartitioned) {
+    double pivot = *begin;
+    double* first = begin;
+    double* last = end;
+
+    while (*++first < pivot) {}
+    if (first - 1 == begin) {
+        while (first < last && !(*--last < pivot)) {}
+    } else {
+        while (!(*--last < pivot)) {}
+    }
+
+    alreadyPartitioned = first >= last;
+    while (first < last) {
+        swapValues(first, last);
+        while (*++first < pivot) {}
+        while (!(*--last < pivot)) {}
+    }
+
+    double* pivotPos = first - 1;
+    *begin = *pivotPos;
+    *pivotPos = pivot;
+    return pivotPos;
+}
+
+// Partitions into [<= pivot] pivot [> pivot]. Used when the pivot equals the
+// element just before this range, so everything equal to it can be skipped.
+static double* partitionLeft(double* begin, double* end) {
+    double pivot = *begin;
+    double* first = begin;
+    double* last = end;
+
+    while (pivot < *--last) {}
+    if (last + 1 == end) {
+        while (first < last && !(pivot < *++first)) {}
+    } else {
+        while (!(pivot < *++first)) {}
+    }
+
+    while (first < last) {
+        swapValues(first, last);
+        while (pivot < *--last) {}
+        while (!(pivot < *++first)) {}
+    }
+
+    *begin = *last;
+    *last = pivot;
+    return last;
+}
+
+static void pdqSort(double* begin, double* end, int badAllowed, bool leftmost) {
+    for (;;) {
+        size_t size = (size_t)(end - begin);
+        if (size < InsertionSortThreshold) {
+            insertionSort(begin, end);
+            return;
+        }
+
+        size_t half = size / 2;
+        if (size > NintherThreshold) {
+            sort3(begin, begin + half, end - 1);
+            sort3(begin + 1, begin + (half - 1), end - 2);
+            sort3(begin + 2, begin + (half + 1), end - 3);
+            sort3(begin + (half - 1), begin + half, begin + (half + 1));
+            swapValues(begin, begin + half);
+        } else {
+            sort3(begin + half, begin, end - 1);
+        }
+
+        if (!leftmost && !(begin[-1] < *begin)) {
+            begin = partitionLeft(begin, end) + 1;
+            continue;
+        }
+
+        bool alreadyPartitioned;
+        double* pivotPos = partitionRight(begin, end, alreadyPartitioned);
+        size_t leftSize = (size_t)(pivotPos - begin);
+        size_t rightSize = (size_t)(end - (pivotPos + 1));
+
+        if (leftSize < size / 8 || rightSize < size / 8) {
+            if (--badAllowed == 0) {
+                heapSort(begin, end);
+                return;
+            }
+            // Break up patterns that keep producing bad pivots
+            if (leftSize >= InsertionSortThreshold) {
+                swapValues(begin, begin + leftSize / 4);
+                swapValues(pivotPos - 1, pivotPos - leftSize / 4);
+            }
+            if (rightSize >= InsertionSortThreshold) {
+                swapValues(pivotPos + 1, pivotPos + 1 + rightSize / 4);
+                swapValues(end - 1, end - rightSize / 4);
+            }
+        } else if (alreadyPartitioned &&
+                   partialInsertionSort(begin, pivotPos) &&
+                   partialInsertionSort(pivotPos + 1, end)) {
+            return;
+        }
+
+        pdqSort(begin, pivotPos, badAllowed, leftmost);
+        begin = pivotPos + 1;
+        leftmost = false;
+    }
+}
+
+// Maps a double's bits to an unsigned key with the same order: negative
+// values have all bits flipped, positive values only the sign bit.
+static inline uint64_t radixKey(uint64_t bits) {
+    uint64_t mask = (uint64_t)(-(int64_t)(bits >> 63)) | 0x8000000000000000ULL;
+    return bits ^ mask;
+}
+
+static inline uint64_t radixValue(uint64_t key) {
+    uint64_t mask = ((key >> 63) - 1) | 0x8000000000000000ULL;
+    return key ^ mask;
+}
+
+static void radixSort(double* values, size_t count) {
+    const unsigned DigitBits = 11;
+    const unsigned Passes = 6;
+    const size_t Buckets = (size_t)1 << DigitBits;
+
+    uint64_t* keys = (uint64_t*)values;
+    uint64_t* buffer = (uint64_t*)malloc(count * sizeof(uint64_t));
+
+    // All six histograms are built in a single read of the input
+    size_t* histograms = (size_t*)calloc(Passes * Buckets, sizeof(size_t));
+    for (size_t i = 0; i < count; i++) {
+        uint64_t bits;
+        memcpy(&bits, values + i, sizeof(bits));
+        uint64_t key = radixKey(bits);
+        keys[i] = key;
+        for (unsigned pass = 0; pass < Passes; pass++) {
+            histograms[pass * Buckets + ((key >> (pass * DigitBits)) & (Buckets - 1))]++;
+        }
+    }
+
+    uint64_t* src = keys;
+    uint64_t* dst = buffer;
+    for (unsigned pass = 0; pass < Passes; pass++) {
+        size_t* histogram = histograms + pass * Buckets;
+        unsigned shift = pass * DigitBits;
+
+        // A digit shared by every key doesn't change the order
+        if (histogram[(src[0] >> shift) & (Buckets - 1)] == count) continue;
+
+        size_t offset = 0;
+        for (size_t b = 0; b < Buckets; b++) {
+            size_t bucketCount = histogram[b];
+            histogram[b] = offset;
+            offset += bucketCount;
+        }
+        for (size_t i = 0; i < count; i++) {
+            uint64_t key = src[i];
+            dst[histogram[(key >> shift) & (Buckets - 1)]++] = key;
+        }
+
+        uint64_t* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        uint64_t bits = radixValue(src[i]);
+        memcpy(values + i, &bits, sizeof(bits));
+    }
+
+    free(histograms);
+    free(buffer);
+}
+
+static void sortValues(double* values, size_t count) {
+    size_t ordered = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (values[i] == values[i]) swapValues(values + ordered++, values + i);
+    }
+
+    if (ordered >= RadixSortThreshold) {
+        radixSort(values, ordered);
+    } else if (ordered > 1) {
+        int badAllowed = 1;
+        for (size_t n = ordered; n > 1; n >>= 1) badAllowed++;
+        pdqSort(values, values + ordered, badAllowed, true);
+    }
+}
+
+void* twine_sort(void* array) {
+    size_t count = twine_array_count(array);
+    if (twine_array_type(array) == TWINE_ELEMENT_F64) {
+        sortValues((double*)array, count);
+        return array;
+    }
+
+    // Typed arrays sort a widened copy; every value came from the array,
+    // so writing it back converts exactly
+    double* values = (double*)malloc((count ? count : 1) * sizeof(double));
+    twine_array_load_f64(values, array, 0, count);
+    sortValues(values, count);
+    for (size_t i = 0; i < count; i++) twine_array_set(array, (double)i, values[i]);
+    free(values);
+    return array;
+}
+
+double* twine_sorted(const void* array) {
+    size_t count = twine_array_count(array);
+    double* result = twine_array_alloc(count);
+    twine_array_load_f64(result, array, 0, count);
+    sortValues(result, count);
+    return result;
+}
+
+double twine_search_sorted(const void* array, double value) {
+    size_t count = twine_array_count(array);
+    if (twine_array_type(array) != TWINE_ELEMENT_F64) {
+        // Typed arrays: the same lower bound, reading elements by their tag
+        size_t low = 0;
+        while (count > 0) {
+            size_t half = count / 2;
+            if (twine_array_get(array, (double)(low + half)) < value) {
+                low += half + 1;
+                count -= half + 1;
+            } else {
+                count = half;
+            }
+        }
+        return (double)low;
+    }
+
+    // Branch-free lower bound: the first index whose element is not less
+    // than value, or the array length if there is none
+    if (count == 0) return 0.0;
+
+    const double* values = (const double*)array;
+    const double* base = values;
+    while (count > 1) {
+        size_t half = count / 2;
+        base = (base[half] < value) ? base + half : base;
+        count -= half;
+    }
+    return (double)((size_t)(base - values) + (*base < value));
+}
@@ -0,0 +1,143 @@
+#include "twinert.h"
+#include "simd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char* mapString(const char* str, ByteRangeRule rule) {
+    size_t length = strlen(str);
+    char* result = (char*)malloc(length + 1);
+    byteMap(result, str, length, rule);
+    result[length] = '\0';
+    return result;
+}
+
+const char* twine_substr(const char* str, double start, double end) {
+    size_t length = strlen(str);
+    size_t from = twine_slice_bound(start, length);
+    size_t to = twine_slice_bound(end, length);
+    // Suffixes are already NUL-terminated inside the parent, so share it
+    if (to == length) return str + from;
+    if (to < from) to = from;
+
+    char* result = (char*)malloc(to - from + 1);
+    memcpy(result, str + from, to - from);
+    result[to - from] = '\0';
+    return result;
+}
+
+const char* twine_byte_string(int byte) {
+    // One shared 1-byte string per byte value, so s[i] never allocates
+    static char byteStrings[256][2];
+    byte &= 0xFF;
+    byteStrings[byte][0] = (char)byte;
+    return byteStrings[byte];
+}
+
+const char* twine_char_at(const char* str, double index) {
+    // Negative, NaN and past-the-end indexes read as "", like substr
+    if (!(index >= 0.0) || index >= (double)twine_str_length(str)) return "";
+    return twine_byte_string((unsigned char)str[(size_t)index]);
+}
+
+char* twine_upper(const char* str) {
+    return mapString(str, ByteRangeRule{'a', 'z', -32});
+}
+
+char* twine_lower(const char* str) {
+    return mapString(str, ByteRangeRule{'A', 'Z', 32});
+}
+
+// Replaces up to `limit` non-overlapping occurrences of oldStr. Matches are
+// collected in one scan, so the result is allocated at its exact size and
+// filled with memcpy. An empty oldStr matches once, at the start.
+static char* replaceMatches(const char* haystack, const char* oldStr, const char* newStr, size_t limit) {
+    size_t haystackLen = strlen(haystack);
+    size_t oldLen = strlen(oldStr);
+    size_t newLen = strlen(newStr);
+
+    size_t inlineMatches[64];
+    size_t* matches = inlineMatches;
+    size_t capacity = 64;
+    size_t matchCount = 0;
+
+    if (oldLen == 0) {
+        matches[matchCount++] = 0;
+    } else {
+        size_t pos = 0;
+        while (matchCount < limit && pos + oldLen <= haystackLen) {
+            ptrdiff_t found = findSubstring(haystack + pos, haystackLen - pos, oldStr, oldLen);
+            if (found < 0) break;
+            if (matchCount == capacity) {
+                size_t* grown = (size_t*)malloc(capacity * 2 * sizeof(size_t));
+                memcpy(grown, matches, capacity * sizeof(size_t));
+                if (matches != inlineMatches) free(matches);
+                matches = grown;
+                capacity *= 2;
+            }
+            matches[matchCount++] = pos + (size_t)found;
+            pos += (size_t)found + oldLen;
+        }
+    }
+
+    size_t resultLen = haystackLen - matchCount * oldLen + matchCount * newLen;
+    char* result = (char*)malloc(resultLen + 1);
+    char* out = result;
+    size_t copied = 0;
+    for (size_t i = 0; i < matchCount; i++) {
+        size_t gap = matches[i] - copied;
+        memcpy(out, haystack + copied, gap);
+        out += gap;
+        memcpy(out, newStr, newLen);
+        out += newLen;
+        copied = matches[i] + oldLen;
+    }
+    memcpy(out, haystack + copied, haystackLen - copied + 1);
+
+    if (matches != inlineMatches) free(matches);
+    return result;
+}
+
+char* twine_replace(const char* haystack, const char* oldStr, const char* newStr) {
+    return replaceMatches(haystack, oldStr, newStr, 1);
+}
+
+char* twine_replace_all(const char* haystack, const char* oldStr, const char* newStr) {
+    return replaceMatches(haystack, oldStr, newStr, (size_t)-1);
+}
+
+double twine_str_includes(const char* haystack, const char* needle) {
+    return twine_str_index_of(haystack, needle) >= 0 ? 1.0 : 0.0;
+}
+
+double twine_str_index_of(const char* haystack, const char* needle) {
+    return (double)findSubstring(haystack, strlen(haystack), needle, strlen(needle));
+}
+
+void* twine_concat(const void* left, const void* right) {
+    // Two boxed numbers add; otherwise boxes are formatted like str() and
+    // the operands are joined as strings
+    if (twine_is_box(left) && twine_is_box(right)) {
+        return twine_box_number(((const TwineBox*)left)->value + ((const TwineBox*)right)->value);
+    }
+
+    char leftBuffer[32];
+    char rightBuffer[32];
+    const char* leftStr = (const char*)left;
+    const char* rightStr = (const char*)right;
+    if (twine_is_box(left)) {
+        snprintf(leftBuffer, sizeof(leftBuffer), "%g", ((const TwineBox*)left)->value);
+        leftStr = leftBuffer;
+    }
+    if (twine_is_box(right)) {
+        snprintf(rightBuffer, sizeof(rightBuffer), "%g", ((const TwineBox*)right)->value);
+        rightStr = rightBuffer;
+    }
+
+    size_t leftLen = strlen(leftStr);
+    size_t rightLen = strlen(rightStr);
+    char* result = (char*)malloc(leftLen + rightLen + 1);
+    memcpy(result, leftStr, leftLen);
+    memcpy(result + leftLen, rightStr, rightLen + 1);
+    return result;
+}
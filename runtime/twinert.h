@@ -0,0 +1,220 @@
+#ifndef TWINERT_H
+#define TWINERT_H
+
+// Twine runtime library (libtwinert).
+//
+// Builtins that need loops or libc plumbing live here instead of being expanded
+// inline at every call site. The compiler links twinert.bc into each module
+// before optimization so the inliner can decide what to inline, and links
+// libtwinert.a into the executable for anything left as a call.
+//
+// Value layout shared with the code generator:
+//   strings  NUL-terminated char*
+//   arrays   pointer to the first element, preceded by two 8-byte header
+//            slots: the element type tag (u64, array[-2]) and the element
+//            count stored as a double (array[-1]). Number arrays hold f64;
+//            typed arrays pack int32, int64, float32 or single bits. The
+//            first element is always TWINE_ARRAY_ALIGNMENT-byte aligned.
+//            The compiler doesn't always know an array's element type, so
+//            every runtime entry point taking an array reads the tag.
+//   boxes    numbers passed where a pointer is expected (function returns, map
+//            values): a TwineBox, whose tag byte can't start a printable string
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Arrays
+enum TwineElementType {
+    TWINE_ELEMENT_F64 = 0,
+    TWINE_ELEMENT_F32 = 1,
+    TWINE_ELEMENT_I32 = 2,
+    TWINE_ELEMENT_I64 = 3,
+    TWINE_ELEMENT_BIT = 4
+};
+
+double* twine_array_alloc(size_t count);
+void* twine_typed_array_alloc(size_t count, uint32_t elementType);
+double twine_array_get(const void* array, double index);
+double twine_array_set(void* array, double index, double value);
+void* twine_array_fill(void* array, double value);
+double twine_array_includes(const void* array, double value);
+double twine_array_index_of(const void* array, double value);
+double twine_len(const void* value);
+// value[index] for a string or an array told apart as twine_len does: a
+// one-character string, or the element as a boxed number
+void* twine_element_at(const void* value, double index);
+// Copies min(len(dst), len(src)) elements, converting to dst's type
+void* twine_array_copy(void* dst, const void* src);
+// Elements [from, from + count) of any array, as doubles
+void twine_array_load_f64(double* dst, const void* array, size_t from, size_t count);
+
+// These build number arrays, whatever the element type of their input
+double* twine_append(const void* array, double value);
+double* twine_slice(const void* array, double start, double end);
+double* twine_array_concat(const void* left, const void* right);
+
+// Array reductions. A nonzero `stable` selects pairwise summation, which
+// keeps rounding error at O(log n) instead of O(n) at a small speed cost.
+double twine_sum(const void* array, double stable);
+double twine_prod(const void* array);
+double twine_min_of(const void* array);
+double twine_max_of(const void* array);
+double twine_mean(const void* array, double stable);
+double twine_variance(const void* array, double stable);
+double twine_dot(const void* a, const void* b, double stable);
+
+// Sorting. NaNs are placed after all other values. sort() keeps the
+// array's element type; sorted() returns a number array.
+void* twine_sort(void* array);
+double* twine_sorted(const void* array);
+double twine_search_sorted(const void* array, double value);
+
+// Strings
+char* twine_upper(const char* str);
+char* twine_lower(const char* str);
+char* twine_replace(const char* haystack, const char* oldStr, const char* newStr);
+char* twine_replace_all(const char* haystack, const char* oldStr, const char* newStr);
+double twine_str_includes(const char* haystack, const char* needle);
+double twine_str_index_of(const char* haystack, const char* needle);
+void* twine_concat(const void* left, const void* right);
+const char* twine_substr(const char* str, double start, double end);
+// "" when index is negative or past the end
+const char* twine_char_at(const char* str, double index);
+// The shared one-character string for a byte
+const char* twine_byte_string(int byte);
+
+// Interning. String literals are interned before main runs; equal interned
+// strings share one pointer, so twine_str_eq is a pointer compare for them.
+const char* twine_intern(const char* str);
+// == on two pointers whose kinds may be unknown: null equals only null,
+// and boxed numbers compare by value
+int twine_str_eq(const char* left, const char* right);
+// strlen, read from the header for interned strings
+size_t twine_str_length(const char* str);
+// hashBytes() of the string (runtime/hash.h); string switches compare it
+// with the hashes of their case labels, computed at compile time
+uint64_t twine_str_hash(const char* str);
+
+// Maps. Values are boxed (a string, or a TwineBox for numbers); keys are
+// either strings or numbers and the two never compare equal. The _any
+// variants take a pointer key of unknown kind and unbox boxed numbers.
+void* twine_map_new(void);
+void* twine_map_set_num(void* map, double key, void* value);
+void* twine_map_set_str(void* map, const char* key, void* value);
+void* twine_map_set_any(void* map, const void* key, void* value);
+void* twine_map_get_num(void* map, double key, void* fallback);
+void* twine_map_get_str(void* map, const char* key, void* fallback);
+void* twine_map_get_any(void* map, const void* key, void* fallback);
+double twine_map_has_num(void* map, double key);
+double twine_map_has_str(void* map, const char* key);
+double twine_map_has_any(void* map, const void* key);
+double twine_map_delete_num(void* map, double key);
+double twine_map_delete_str(void* map, const char* key);
+double twine_map_delete_any(void* map, const void* key);
+double twine_map_size(void* map);
+double* twine_map_keys(void* map);
+void* twine_map_key_at(void* map, double index);
+
+// I/O
+char* twine_input(void);
+double twine_save_array(const char* path, const double* array);
+double* twine_load_array(const char* path);
+
+// Math
+double twine_random(void);
+
+// CPU dispatch for --target-clones. Each level includes the ones below it;
+// the compiler's clone table (src/codegen.cpp) lists the features per level.
+enum TwineCpuLevel {
+    TWINE_CPU_BASELINE = 0,
+    TWINE_CPU_SSE42 = 1,    // sse4.2, popcnt
+    TWINE_CPU_AVX2 = 2,     // avx2, fma, bmi, bmi2
+    TWINE_CPU_AVX512 = 3    // avx512f, avx512vl, avx512bw, avx512dq, avx512cd
+};
+
+uint32_t twine_cpu_level(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+static const size_t TWINE_ARRAY_ALIGNMENT = 64;
+
+static const uint64_t TWINE_BOX_TAG = 1;
+
+struct TwineBox {
+    uint64_t tag;
+    double value;
+};
+
+static inline size_t twine_array_count(const void* array) {
+    return (size_t)((const double*)array)[-1];
+}
+
+static inline uint32_t twine_array_type(const void* array) {
+    return (uint32_t)((const uint64_t*)array)[-2];
+}
+
+// The elements of an array as doubles, for kernels that only handle f64.
+// Number arrays are read in place; typed arrays are widened into a
+// temporary that lives as long as the view.
+class TwineF64View {
+public:
+    explicit TwineF64View(const void* array) : count(twine_array_count(array)), owned(nullptr) {
+        if (twine_array_type(array) == TWINE_ELEMENT_F64) {
+            values = (const double*)array;
+        } else {
+            owned = (double*)malloc((count ? count : 1) * sizeof(double));
+            twine_array_load_f64(owned, array, 0, count);
+            values = owned;
+        }
+    }
+    ~TwineF64View() { free(owned); }
+    TwineF64View(const TwineF64View&) = delete;
+    TwineF64View& operator=(const TwineF64View&) = delete;
+
+    const double* values;
+    size_t count;
+
+private:
+    double* owned;
+};
+
+// Bytes needed for count elements of a type, rounded up to whole 8-byte words
+static inline size_t twine_array_payload_size(size_t count, uint32_t elementType) {
+    size_t bytes;
+    switch (elementType) {
+        case TWINE_ELEMENT_F32:
+        case TWINE_ELEMENT_I32: bytes = count * 4; break;
+        case TWINE_ELEMENT_BIT: bytes = (count + 7) / 8; break;
+        default: bytes = count * 8; break;
+    }
+    return (bytes + 7) & ~(size_t)7;
+}
+
+// Resolves a slice() or substr() bound: negative values count from the end,
+// and the result is clamped to [0, length].
+static inline size_t twine_slice_bound(double bound, size_t length) {
+    if (bound < 0) bound += (double)length;
+    if (!(bound > 0)) return 0;
+    if (bound >= (double)length) return length;
+    return (size_t)bound;
+}
+
+static inline bool twine_is_box(const void* value) {
+    return *(const unsigned char*)value == (unsigned char)TWINE_BOX_TAG;
+}
+
+static inline void* twine_box_number(double value) {
+    TwineBox* box = (TwineBox*)malloc(sizeof(TwineBox));
+    box->tag = TWINE_BOX_TAG;
+    box->value = value;
+    return box;
+}
+
+#endif // TWINERT_H
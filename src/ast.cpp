@@ -32,10 +32,18 @@ void UnaryExpression::accept(ASTVisitor* visitor) {
     visitor->visit(this);
 }
 
+void ConditionalExpression::accept(ASTVisitor* visitor) {
+    visitor->visit(this);
+}
+
 void AssignmentExpression::accept(ASTVisitor* visitor) {
     visitor->visit(this);
 }
 
+void CompoundAssignmentExpression::accept(ASTVisitor* visitor) {
+    visitor->visit(this);
+}
+
 void IndexAssignmentExpression::accept(ASTVisitor* visitor) {
     visitor->visit(this);
 }
@@ -76,6 +84,22 @@ void ForStatement::accept(ASTVisitor* visitor) {
     visitor->visit(this);
 }
 
+void ForInStatement::accept(ASTVisitor* visitor) {
+    visitor->visit(this);
+}
+
+void SwitchStatement::accept(ASTVisitor* visitor) {
+    visitor->visit(this);
+}
+
+void BreakStatement::accept(ASTVisitor* visitor) {
+    visitor->visit(this);
+}
+
+void ContinueStatement::accept(ASTVisitor* visitor) {
+    visitor->visit(this);
+}
+
 void ReturnStatement::accept(ASTVisitor* visitor) {
     visitor->visit(this);
 }
@@ -1,15 +1,27 @@
 #include "../include/codegen.h"
+#include "../runtime/hash.h"
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Linker/Linker.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/SourceMgr.h>
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ADT/Triple.h>
 #include <iostream>
+#include <algorithm>
+#include <functional>
+#include <cmath>
 #include <cstdlib>
 
 CodeGenerator::CodeGenerator(const std::string& moduleName) {
@@ -42,16 +54,24 @@ llvm::AllocaInst* CodeGenerator::createEntryBlockAlloca(llvm::Function* function
     return tmpBuilder.CreateAlloca(type, nullptr, varName);
 }
 
-llvm::Value* CodeGenerator::getVariable(const std::string& name) {
+llvm::AllocaInst* CodeGenerator::findVariable(const std::string& name) {
     for (auto it = symbolTables.rbegin(); it != symbolTables.rend(); ++it) {
         auto var = it->find(name);
         if (var != it->end()) {
-            return builder->CreateLoad(var->second->getAllocatedType(), var->second, name);
+            return var->second;
         }
     }
     return nullptr;
 }
 
+llvm::Value* CodeGenerator::getVariable(const std::string& name) {
+    llvm::AllocaInst* alloca = findVariable(name);
+    if (!alloca) {
+        return nullptr;
+    }
+    return builder->CreateLoad(alloca->getAllocatedType(), alloca, name);
+}
+
 void CodeGenerator::setVariable(const std::string& name, llvm::Value* value) {
     for (auto it = symbolTables.rbegin(); it != symbolTables.rend(); ++it) {
         auto var = it->find(name);
@@ -76,6 +96,394 @@ void CodeGenerator::setVariable(const std::string& name, llvm::Value* value) {
     }
 }
 
+CodeGenerator::ValueKind CodeGenerator::expressionKind(Expression* expr) {
+    static const std::set<std::string> stringBuiltins = {
+        "input", "str", "upper", "lower", "replace", "replaceAll", "intern", "substr"
+    };
+    static const std::set<std::string> arrayBuiltins = {
+        "append", "sorted", "keys", "array", "range"
+    };
+    static const std::map<std::string, ValueKind> typedArrayBuiltins = {
+        {"intArray", ValueKind::Int32Array}, {"int64Array", ValueKind::Int64Array},
+        {"floatArray", ValueKind::Float32Array}, {"bitArray", ValueKind::BitArray}
+    };
+    static const std::set<std::string> mapBuiltins = {
+        "map", "set"
+    };
+    static const std::set<std::string> unknownBuiltins = {
+        "get", "keyAt"
+    };
+    
+    if (!expr) {
+        return ValueKind::Unknown;
+    } else if (dynamic_cast<StringLiteral*>(expr)) {
+        return ValueKind::String;
+    } else if (dynamic_cast<ArrayLiteral*>(expr)) {
+        return ValueKind::Array;
+    } else if (dynamic_cast<NumberLiteral*>(expr) || dynamic_cast<BooleanLiteral*>(expr) ||
+               dynamic_cast<UnaryExpression*>(expr)) {
+        return ValueKind::Number;
+    } else if (auto* index = dynamic_cast<IndexExpression*>(expr)) {
+        ValueKind arrayKind = expressionKind(index->array.get());
+        if (arrayKind == ValueKind::String || arrayKind == ValueKind::Unknown) return arrayKind;
+        return ValueKind::Number;
+    } else if (auto* identifier = dynamic_cast<Identifier*>(expr)) {
+        auto it = variableKinds.find(findVariable(identifier->name));
+        return it != variableKinds.end() ? it->second : ValueKind::Unknown;
+    } else if (auto* assignment = dynamic_cast<AssignmentExpression*>(expr)) {
+        return expressionKind(assignment->value.get());
+    } else if (auto* compound = dynamic_cast<CompoundAssignmentExpression*>(expr)) {
+        // Only += on a string variable can make something other than a number
+        bool concatenates = compound->op == "+" && dynamic_cast<Identifier*>(compound->target.get()) &&
+                            (expressionKind(compound->target.get()) == ValueKind::String ||
+                             expressionKind(compound->value.get()) == ValueKind::String);
+        return concatenates ? ValueKind::String : ValueKind::Number;
+    } else if (auto* conditional = dynamic_cast<ConditionalExpression*>(expr)) {
+        ValueKind thenKind = expressionKind(conditional->thenValue.get());
+        return thenKind == expressionKind(conditional->elseValue.get()) ? thenKind : ValueKind::Unknown;
+    } else if (auto* binary = dynamic_cast<BinaryExpression*>(expr)) {
+        if (binary->op == "+") {
+            ValueKind left = expressionKind(binary->left.get());
+            ValueKind right = expressionKind(binary->right.get());
+            if (left == ValueKind::String || right == ValueKind::String) return ValueKind::String;
+            if (left == ValueKind::Number && right == ValueKind::Number) return ValueKind::Number;
+            return ValueKind::Unknown;
+        }
+        return ValueKind::Number;
+    } else if (auto* call = dynamic_cast<CallExpression*>(expr)) {
+        // These return their first argument, typed or not
+        if ((call->name == "fill" || call->name == "copy" || call->name == "sort") && !call->arguments.empty()) {
+            return expressionKind(call->arguments[0].get());
+        }
+        auto typed = typedArrayBuiltins.find(call->name);
+        if (typed != typedArrayBuiltins.end()) return typed->second;
+        // Files keep their element type, which is only known at run time
+        if (call->name == "loadArray") return ValueKind::AnyArray;
+        if (call->name == "slice" || call->name == "concat") {
+            // These work on strings too, and then return strings
+            for (auto& argument : call->arguments) {
+                if (expressionKind(argument.get()) == ValueKind::String) return ValueKind::String;
+            }
+            return ValueKind::Array;
+        }
+        if (stringBuiltins.count(call->name)) return ValueKind::String;
+        if (arrayBuiltins.count(call->name)) return ValueKind::Array;
+        if (mapBuiltins.count(call->name)) return ValueKind::Map;
+        // User functions return boxed values of any kind
+        if (unknownBuiltins.count(call->name) || functions.count(call->name)) return ValueKind::Unknown;
+        return ValueKind::Number;
+    }
+    return ValueKind::Unknown;
+}
+
+void CodeGenerator::recordVariableKind(const std::string& name, ValueKind kind) {
+    llvm::AllocaInst* alloca = findVariable(name);
+    if (!alloca) return;
+    
+    // A variable assigned values of different kinds could hold either;
+    // if both are arrays it still is one, with the element type in its tag
+    auto it = variableKinds.find(alloca);
+    if (it == variableKinds.end()) {
+        variableKinds[alloca] = kind;
+    } else if (it->second != kind) {
+        it->second = isArrayKind(it->second) && isArrayKind(kind) ? ValueKind::AnyArray : ValueKind::Unknown;
+    }
+}
+
+llvm::Value* CodeGenerator::createArrayAlloc(llvm::Value* count) {
+    llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+    llvm::Function* allocFunc = declareRuntimeFunction("twine_array_alloc", ptrType, {llvm::Type::getInt64Ty(*context)});
+    return markArrayResult(builder->CreateCall(allocFunc, {count}, "array"));
+}
+
+llvm::Value* CodeGenerator::markArrayResult(llvm::CallInst* call, bool freshAllocation) {
+    // Runtime array payloads start on a cache line. The return attribute
+    // survives runtime linking; the assumption carries the fact through
+    // variables and loops so vectorized accesses can use aligned loads.
+    // A fresh array also can't alias anything the program already holds.
+    if (freshAllocation) {
+        call->addRetAttr(llvm::Attribute::NoAlias);
+    }
+    call->addRetAttr(llvm::Attribute::getWithAlignment(*context, llvm::Align(ARRAY_ALIGNMENT)));
+    builder->CreateAlignmentAssumption(module->getDataLayout(), call, ARRAY_ALIGNMENT);
+    return call;
+}
+
+llvm::Value* CodeGenerator::loadArrayCount(llvm::Value* arrayPtr) {
+    llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+    llvm::Value* countPtr = builder->CreateInBoundsGEP(doubleType, arrayPtr, getInt64(-1));
+    llvm::Value* count = builder->CreateLoad(doubleType, countPtr, "count");
+    tagAccess(count, "array header");
+    return toCount(count);
+}
+
+llvm::MDNode* CodeGenerator::getTBAATag(const std::string& typeName) {
+    auto it = tbaaTags.find(typeName);
+    if (it != tbaaTags.end()) {
+        return it->second;
+    }
+    
+    // Every type hangs directly off the root, so accesses with different
+    // types never alias. The runtime's own accesses carry clang's TBAA
+    // under a different root and stay conservatively may-alias with these.
+    llvm::MDBuilder mdBuilder(*context);
+    llvm::MDNode* root = mdBuilder.createTBAARoot("Twine TBAA");
+    llvm::MDNode* type = mdBuilder.createTBAAScalarTypeNode(typeName, root);
+    llvm::MDNode* tag = mdBuilder.createTBAAStructTagNode(type, type, 0);
+    tbaaTags[typeName] = tag;
+    return tag;
+}
+
+void CodeGenerator::tagAccess(llvm::Value* access, const std::string& typeName) {
+    if (auto* inst = llvm::dyn_cast<llvm::Instruction>(access)) {
+        inst->setMetadata(llvm::LLVMContext::MD_tbaa, getTBAATag(typeName));
+    }
+}
+
+const char* CodeGenerator::elementTBAAType(ValueKind kind) {
+    switch (kind) {
+        case ValueKind::Int32Array: return "array i32";
+        case ValueKind::Int64Array: return "array i64";
+        case ValueKind::Float32Array: return "array f32";
+        case ValueKind::BitArray: return "array bits";
+        default: return "array f64";
+    }
+}
+
+llvm::Value* CodeGenerator::createElementAddress(ValueKind kind, llvm::Value* arrayPtr, llvm::Value* index) {
+    switch (kind) {
+        case ValueKind::Int32Array:
+            return builder->CreateInBoundsGEP(builder->getInt32Ty(), arrayPtr, index);
+        case ValueKind::Int64Array:
+            return builder->CreateInBoundsGEP(builder->getInt64Ty(), arrayPtr, index);
+        case ValueKind::Float32Array:
+            return builder->CreateInBoundsGEP(builder->getFloatTy(), arrayPtr, index);
+        case ValueKind::BitArray:
+            // Address of the byte holding the bit
+            return builder->CreateInBoundsGEP(builder->getInt8Ty(), arrayPtr, builder->CreateLShr(index, getInt64(3)));
+        default:
+            return builder->CreateInBoundsGEP(builder->getDoubleTy(), arrayPtr, index);
+    }
+}
+
+llvm::Value* CodeGenerator::createElementLoad(ValueKind kind, llvm::Value* elementPtr, llvm::Value* index) {
+    llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+    auto loadElement = [&](llvm::Type* type) {
+        llvm::Value* element = builder->CreateLoad(type, elementPtr);
+        tagAccess(element, elementTBAAType(kind));
+        return element;
+    };
+    
+    switch (kind) {
+        case ValueKind::Int32Array:
+            return builder->CreateSIToFP(loadElement(builder->getInt32Ty()), doubleType);
+        case ValueKind::Int64Array:
+            return builder->CreateSIToFP(loadElement(builder->getInt64Ty()), doubleType);
+        case ValueKind::Float32Array:
+            return builder->CreateFPExt(loadElement(builder->getFloatTy()), doubleType);
+        case ValueKind::BitArray: {
+            // index picks the bit within the byte at elementPtr
+            llvm::Value* byte = loadElement(builder->getInt8Ty());
+            llvm::Value* shift = builder->CreateTrunc(builder->CreateAnd(index, getInt64(7)), builder->getInt8Ty());
+            llvm::Value* bit = builder->CreateAnd(builder->CreateLShr(byte, shift), builder->getInt8(1));
+            return builder->CreateUIToFP(bit, doubleType);
+        }
+        default:
+            return loadElement(doubleType);
+    }
+}
+
+void CodeGenerator::createElementStore(ValueKind kind, llvm::Value* elementPtr, llvm::Value* index, llvm::Value* value) {
+    llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+    auto storeElement = [&](llvm::Value* element) {
+        tagAccess(builder->CreateStore(element, elementPtr), elementTBAAType(kind));
+    };
+    
+    switch (kind) {
+        case ValueKind::Int32Array:
+            storeElement(builder->CreateFPToSI(value, builder->getInt32Ty()));
+            break;
+        case ValueKind::Int64Array:
+            storeElement(builder->CreateFPToSI(value, builder->getInt64Ty()));
+            break;
+        case ValueKind::Float32Array:
+            storeElement(builder->CreateFPTrunc(value, builder->getFloatTy()));
+            break;
+        case ValueKind::BitArray: {
+            // Read-modify-write of the byte holding the bit
+            llvm::Value* byte = builder->CreateLoad(builder->getInt8Ty(), elementPtr);
+            tagAccess(byte, elementTBAAType(kind));
+            llvm::Value* shift = builder->CreateTrunc(builder->CreateAnd(index, getInt64(7)), builder->getInt8Ty());
+            llvm::Value* mask = builder->CreateShl(builder->getInt8(1), shift);
+            llvm::Value* cleared = builder->CreateAnd(byte, builder->CreateNot(mask));
+            llvm::Value* bit = builder->CreateZExt(builder->CreateFCmpONE(value, llvm::ConstantFP::get(doubleType, 0.0)), builder->getInt8Ty());
+            storeElement(builder->CreateOr(cleared, builder->CreateShl(bit, shift)));
+            break;
+        }
+        default:
+            storeElement(value);
+            break;
+    }
+}
+
+void CodeGenerator::createArrayFill(llvm::Value* dataPtr, llvm::Value* count, llvm::Value* value) {
+    llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+    
+    // +0.0 is all zero bits, so it can be a plain memset
+    auto* constant = llvm::dyn_cast<llvm::ConstantFP>(value);
+    if (constant && constant->isZero() && !constant->isNegative()) {
+        llvm::Value* byteCount = builder->CreateMul(count, getInt64(8));
+        builder->CreateMemSet(dataPtr, builder->getInt8(0), byteCount, llvm::MaybeAlign(8));
+        return;
+    }
+    
+    // Other values get a simple store loop, which the loop vectorizer
+    // turns into wide stores
+    llvm::BasicBlock* preheader = builder->GetInsertBlock();
+    llvm::BasicBlock* loopBlock = llvm::BasicBlock::Create(*context, "fill_loop", currentFunction);
+    llvm::BasicBlock* doneBlock = llvm::BasicBlock::Create(*context, "fill_done", currentFunction);
+    
+    builder->CreateCondBr(builder->CreateICmpEQ(count, getInt64(0)), doneBlock, loopBlock);
+    
+    builder->SetInsertPoint(loopBlock);
+    llvm::PHINode* index = builder->CreatePHI(llvm::Type::getInt64Ty(*context), 2, "i");
+    index->addIncoming(getInt64(0), preheader);
+    tagAccess(builder->CreateStore(value, builder->CreateInBoundsGEP(doubleType, dataPtr, index)), "array f64");
+    llvm::Value* next = builder->CreateNUWAdd(index, getInt64(1));
+    index->addIncoming(next, loopBlock);
+    builder->CreateCondBr(builder->CreateICmpULT(next, count), loopBlock, doneBlock);
+    
+    builder->SetInsertPoint(doneBlock);
+}
+
+CallExpression* CodeGenerator::asRangeCall(Expression* expr) {
+    auto* call = dynamic_cast<CallExpression*>(expr);
+    return call && call->name == "range" ? call : nullptr;
+}
+
+void CodeGenerator::createRangeBounds(CallExpression* range, llvm::Value*& start, llvm::Value*& step,
+                                      llvm::Value*& count) {
+    // range(end), range(start, end) or range(start, end, step); element k is
+    // start + k * step, for the ceil((end - start) / step) values of k that
+    // are >= 0. A zero or NaN step gives an empty range.
+    if (range->arguments.empty() || range->arguments.size() > 3) {
+        throw std::runtime_error("range() expects 1 to 3 arguments");
+    }
+    std::vector<llvm::Value*> args;
+    for (auto& argument : range->arguments) {
+        argument->accept(this);
+        args.push_back(convertToDouble(valueStack.top()));
+        valueStack.pop();
+    }
+    
+    llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+    llvm::Type* int64Type = llvm::Type::getInt64Ty(*context);
+    start = args.size() > 1 ? args[0] : llvm::ConstantFP::get(doubleType, 0.0);
+    llvm::Value* end = args.size() > 1 ? args[1] : args[0];
+    step = args.size() > 2 ? args[2] : llvm::ConstantFP::get(doubleType, 1.0);
+    
+    llvm::Value* steps = builder->CreateUnaryIntrinsic(llvm::Intrinsic::ceil,
+                                                       builder->CreateFDiv(builder->CreateFSub(end, start), step));
+    steps = builder->CreateIntrinsic(llvm::Intrinsic::fptosi_sat, {int64Type, doubleType}, {steps});
+    llvm::Value* nonEmpty = builder->CreateAnd(builder->CreateFCmpUNE(step, llvm::ConstantFP::get(doubleType, 0.0)),
+                                               builder->CreateICmpSGT(steps, getInt64(0)));
+    count = builder->CreateSelect(nonEmpty, steps, getInt64(0), "range.count");
+}
+
+llvm::Value* CodeGenerator::createRangeReduction(CallExpression* node, CallExpression* range) {
+    llvm::Value* start = nullptr;
+    llvm::Value* step = nullptr;
+    llvm::Value* count = nullptr;
+    createRangeBounds(range, start, step, count);
+    if (node->arguments.size() == 2) {
+        // The stable flag changes nothing here, but still gets evaluated
+        node->arguments[1]->accept(this);
+        valueStack.pop();
+    }
+    
+    llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+    llvm::Value* nan = llvm::ConstantFP::getNaN(doubleType);
+    llvm::Value* n = builder->CreateUIToFP(count, doubleType);
+    llvm::Value* isEmpty = builder->CreateICmpEQ(count, getInt64(0));
+    
+    // Ranges are arithmetic sequences, so everything but prod() has a
+    // closed form in terms of the first and last element
+    llvm::Value* last = builder->CreateFAdd(start, builder->CreateFMul(builder->CreateFSub(n, llvm::ConstantFP::get(doubleType, 1.0)), step));
+    llvm::Value* midpoint = builder->CreateFMul(builder->CreateFAdd(start, last), llvm::ConstantFP::get(doubleType, 0.5));
+    if (node->name == "sum") {
+        return builder->CreateSelect(isEmpty, llvm::ConstantFP::get(doubleType, 0.0), builder->CreateFMul(n, midpoint));
+    } else if (node->name == "mean") {
+        return builder->CreateSelect(isEmpty, nan, midpoint);
+    } else if (node->name == "variance") {
+        // step^2 * (n^2 - 1) / 12
+        llvm::Value* spread = builder->CreateFSub(builder->CreateFMul(n, n), llvm::ConstantFP::get(doubleType, 1.0));
+        llvm::Value* variance = builder->CreateFDiv(builder->CreateFMul(builder->CreateFMul(step, step), spread),
+                                                    llvm::ConstantFP::get(doubleType, 12.0));
+        return builder->CreateSelect(isEmpty, nan, variance);
+    } else if (node->name == "minOf" || node->name == "maxOf") {
+        llvm::Value* extreme = node->name == "minOf" ? builder->CreateMinNum(start, last) : builder->CreateMaxNum(start, last);
+        return builder->CreateSelect(isEmpty, nan, extreme);
+    }
+    
+    // prod(): a counted loop over the elements
+    llvm::BasicBlock* preheader = builder->GetInsertBlock();
+    llvm::BasicBlock* loopBlock = llvm::BasicBlock::Create(*context, "range_prod", currentFunction);
+    llvm::BasicBlock* doneBlock = llvm::BasicBlock::Create(*context, "range_prod_done", currentFunction);
+    llvm::Value* one = llvm::ConstantFP::get(doubleType, 1.0);
+    builder->CreateCondBr(isEmpty, doneBlock, loopBlock);
+    
+    builder->SetInsertPoint(loopBlock);
+    llvm::PHINode* index = builder->CreatePHI(llvm::Type::getInt64Ty(*context), 2, "i");
+    llvm::PHINode* product = builder->CreatePHI(doubleType, 2, "product");
+    index->addIncoming(getInt64(0), preheader);
+    product->addIncoming(one, preheader);
+    llvm::Value* element = builder->CreateFAdd(start, builder->CreateFMul(builder->CreateUIToFP(index, doubleType), step));
+    llvm::Value* nextProduct = builder->CreateFMul(product, element);
+    llvm::Value* next = builder->CreateNUWAdd(index, getInt64(1));
+    index->addIncoming(next, loopBlock);
+    product->addIncoming(nextProduct, loopBlock);
+    builder->CreateCondBr(builder->CreateICmpULT(next, count), loopBlock, doneBlock);
+    
+    builder->SetInsertPoint(doneBlock);
+    llvm::PHINode* result = builder->CreatePHI(doubleType, 2, "prod");
+    result->addIncoming(one, preheader);
+    result->addIncoming(nextProduct, loopBlock);
+    return result;
+}
+
+bool CodeGenerator::isTypedArrayKind(ValueKind kind) {
+    return kind == ValueKind::Int32Array || kind == ValueKind::Int64Array ||
+           kind == ValueKind::Float32Array || kind == ValueKind::BitArray;
+}
+
+bool CodeGenerator::isArrayKind(ValueKind kind) {
+    return kind == ValueKind::Array || kind == ValueKind::AnyArray || isTypedArrayKind(kind);
+}
+
+void CodeGenerator::emitLiteralInterning() {
+    if (internedLiterals.empty()) return;
+    
+    llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+    llvm::Function* initFunc = llvm::Function::Create(
+        llvm::FunctionType::get(llvm::Type::getVoidTy(*context), false),
+        llvm::Function::InternalLinkage,
+        "twine.intern_literals",
+        module.get()
+    );
+    
+    llvm::IRBuilder<> initBuilder(llvm::BasicBlock::Create(*context, "entry", initFunc));
+    llvm::Function* internFunc = declareRuntimeFunction("twine_intern", ptrType, {ptrType});
+    for (auto& literal : internedLiterals) {
+        llvm::GlobalVariable* slot = literal.second;
+        llvm::Value* interned = initBuilder.CreateCall(internFunc, {slot->getInitializer()});
+        initBuilder.CreateStore(interned, slot);
+    }
+    initBuilder.CreateRetVoid();
+    
+    // Runs before main, so every literal already points into the intern table
+    llvm::appendToGlobalCtors(*module, initFunc, 0);
+}
+
 void CodeGenerator::declareBuiltinFunctions() {
     declarePrintf();
     declareScanf();
@@ -550,6 +958,7 @@ llvm::Function* CodeGenerator::declareFabs() {
         module.get()
     );
     
+    markMathFunction(fabsFunc);
     functions["fabs"] = fabsFunc;
     return fabsFunc;
 }
@@ -572,6 +981,7 @@ llvm::Function* CodeGenerator::declareRound() {
         module.get()
     );
     
+    markMathFunction(roundFunc);
     functions["mathRound"] = roundFunc;
     return roundFunc;
 }
@@ -594,6 +1004,7 @@ llvm::Function* CodeGenerator::declareFloor() {
         module.get()
     );
     
+    markMathFunction(floorFunc);
     functions["mathFloor"] = floorFunc;
     return floorFunc;
 }
@@ -616,6 +1027,7 @@ llvm::Function* CodeGenerator::declareCeil() {
         module.get()
     );
     
+    markMathFunction(ceilFunc);
     functions["mathCeil"] = ceilFunc;
     return ceilFunc;
 }
@@ -638,6 +1050,7 @@ llvm::Function* CodeGenerator::declareSin() {
         module.get()
     );
     
+    markMathFunction(sinFunc);
     functions["mathSin"] = sinFunc;
     return sinFunc;
 }
@@ -660,6 +1073,7 @@ llvm::Function* CodeGenerator::declareCos() {
         module.get()
     );
     
+    markMathFunction(cosFunc);
     functions["mathCos"] = cosFunc;
     return cosFunc;
 }
@@ -682,6 +1096,7 @@ llvm::Function* CodeGenerator::declareTan() {
         module.get()
     );
     
+    markMathFunction(tanFunc);
     functions["mathTan"] = tanFunc;
     return tanFunc;
 }
@@ -705,6 +1120,7 @@ llvm::Function* CodeGenerator::declarePow() {
         module.get()
     );
     
+    markMathFunction(powFunc);
     functions["mathPow"] = powFunc;
     return powFunc;
 }
@@ -727,6 +1143,7 @@ llvm::Function* CodeGenerator::declareSqrt() {
         module.get()
     );
     
+    markMathFunction(sqrtFunc);
     functions["mathSqrt"] = sqrtFunc;
     return sqrtFunc;
 }
@@ -806,6 +1223,7 @@ llvm::Value* CodeGenerator::getInt32(int32_t value) {
 }
 
 llvm::Value* CodeGenerator::isStringPointer(llvm::Value* ptrValue, bool allowEmptyStrings) {
+    // No TBAA here: the first byte may belong to a string, a box or an array
     llvm::Value* firstByte = builder->CreateLoad(llvm::Type::getInt8Ty(*context), 
         builder->CreateBitCast(ptrValue, llvm::PointerType::getUnqual(llvm::Type::getInt8Ty(*context))));
     
@@ -864,11 +1282,14 @@ llvm::Value* CodeGenerator::boxValue(llvm::Value* value) {
             mallocFunc = module->getFunction("malloc");
         }
         
-        llvm::Value* size = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 8); // sizeof(double)
+        // Box layout matches TwineBox in runtime/twinert.h: a tag word whose
+        // first byte is never a string's first byte, then the value
+        llvm::Value* size = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 16);
         llvm::Value* ptr = builder->CreateCall(mallocFunc, {size});
-        llvm::Value* doublePtr = builder->CreateBitCast(ptr, llvm::PointerType::getUnqual(llvm::Type::getDoubleTy(*context)));
-        builder->CreateStore(value, doublePtr);
-        return builder->CreateBitCast(doublePtr, llvm::PointerType::getUnqual(*context));
+        tagAccess(builder->CreateStore(getInt64(1), ptr), "box");
+        llvm::Value* valuePtr = builder->CreateConstInBoundsGEP1_64(llvm::Type::getInt8Ty(*context), ptr, 8);
+        tagAccess(builder->CreateStore(value, valuePtr), "box");
+        return ptr;
     } else {
         llvm::Value* doubleVal = convertToDouble(value);
         return boxValue(doubleVal);
@@ -894,8 +1315,9 @@ llvm::Value* CodeGenerator::unboxPointerToDouble(llvm::Value* ptrValue) {
     builder->CreateBr(mergeBlock);
     
     builder->SetInsertPoint(boxedBlock);
-    llvm::Value* doublePtr = builder->CreateBitCast(ptrValue, llvm::PointerType::getUnqual(llvm::Type::getDoubleTy(*context)));
-    llvm::Value* boxedResult = builder->CreateLoad(llvm::Type::getDoubleTy(*context), doublePtr);
+    llvm::Value* valuePtr = builder->CreateConstInBoundsGEP1_64(llvm::Type::getInt8Ty(*context), ptrValue, 8);
+    llvm::Value* boxedResult = builder->CreateLoad(llvm::Type::getDoubleTy(*context), valuePtr);
+    tagAccess(boxedResult, "box");
     builder->CreateBr(mergeBlock);
     
     builder->SetInsertPoint(mergeBlock);
@@ -954,14 +1376,26 @@ bool CodeGenerator::generate(Program* program) {
             module.get()
         );
         
-        llvm::BasicBlock* entry = llvm::BasicBlock::Create(*context, "entry", mainFunc);
+        // main itself can't be multiversioned, so with target clones the
+        // top-level code goes into its own function that main calls
+        llvm::Function* topLevelFunc = mainFunc;
+        if (!targetClones.empty()) {
+            topLevelFunc = llvm::Function::Create(mainType, llvm::Function::InternalLinkage,
+                                                  "twine.main", module.get());
+            llvm::IRBuilder<> mainBuilder(llvm::BasicBlock::Create(*context, "entry", mainFunc));
+            mainBuilder.CreateRet(mainBuilder.CreateCall(topLevelFunc));
+        }
+        
+        llvm::BasicBlock* entry = llvm::BasicBlock::Create(*context, "entry", topLevelFunc);
         builder->SetInsertPoint(entry);
         
-        currentFunction = mainFunc;
+        currentFunction = topLevelFunc;
         
         program->accept(this);
         builder->CreateRet(llvm::ConstantInt::get(*context, llvm::APInt(32, 0)));
         
+        emitLiteralInterning();
+        
         std::string error;
         llvm::raw_string_ostream errorStream(error);
         if (llvm::verifyModule(*module, &errorStream)) {
@@ -976,6 +1410,166 @@ bool CodeGenerator::generate(Program* program) {
     }
 }
 
+bool CodeGenerator::linkRuntime(const std::string& bitcodeFile) {
+    llvm::SMDiagnostic diagnostic;
+    std::unique_ptr<llvm::Module> runtime = llvm::parseIRFile(bitcodeFile, diagnostic, *context);
+    if (!runtime) {
+        std::cerr << "Error reading runtime bitcode " << bitcodeFile << ": "
+                  << diagnostic.getMessage().str() << std::endl;
+        return false;
+    }
+    
+    // Only pull in the runtime functions this program actually calls
+    if (llvm::Linker::linkModules(*module, std::move(runtime), llvm::Linker::LinkOnlyNeeded)) {
+        std::cerr << "Error linking runtime bitcode " << bitcodeFile << std::endl;
+        return false;
+    }
+    
+    // Runtime definitions are private to this program, which lets the
+    // optimizer inline them and drop whatever is left unused. llvm.* globals
+    // such as llvm.global_ctors must keep their appending linkage.
+    for (llvm::Function& function : *module) {
+        if (!function.isDeclaration() && function.getName() != "main") {
+            function.setLinkage(llvm::GlobalValue::InternalLinkage);
+        }
+    }
+    for (llvm::GlobalVariable& global : module->globals()) {
+        if (!global.isDeclaration() && !global.getName().substr(0, 5).equals("llvm.")) {
+            global.setLinkage(llvm::GlobalValue::InternalLinkage);
+        }
+    }
+    
+    return true;
+}
+
+// ISA levels for --target-clones. The level numbers match TwineCpuLevel in
+// runtime/twinert.h, and each level's features include the ones below it.
+struct CloneTarget {
+    const char* name;
+    uint32_t cpuLevel;
+    const char* features;
+};
+
+static const CloneTarget cloneTargets[] = {
+    {"sse4.2", 1, "+sse3,+ssse3,+sse4.1,+sse4.2,+popcnt"},
+    {"avx2", 2, "+sse3,+ssse3,+sse4.1,+sse4.2,+popcnt,+avx,+avx2,+fma,+bmi,+bmi2"},
+    {"avx512f", 3, "+sse3,+ssse3,+sse4.1,+sse4.2,+popcnt,+avx,+avx2,+fma,+bmi,+bmi2,"
+                   "+avx512f,+avx512vl,+avx512bw,+avx512dq,+avx512cd"},
+};
+
+bool CodeGenerator::setTargetClones(const std::vector<std::string>& isas) {
+    for (const std::string& isa : isas) {
+        bool known = false;
+        for (const CloneTarget& target : cloneTargets) {
+            known = known || isa == target.name;
+        }
+        if (!known) {
+            std::cerr << "Unknown --target-clones ISA '" << isa << "' (expected sse4.2, avx2 or avx512f)" << std::endl;
+            return false;
+        }
+    }
+    targetClones = isas;
+    return true;
+}
+
+void CodeGenerator::emitTargetClones() {
+    if (targetClones.empty()) {
+        return;
+    }
+    
+    // Per-function target features only take effect with a known target;
+    // the runtime bitcode normally provides it
+    if (module->getTargetTriple().empty()) {
+        module->setTargetTriple(LLVM_DEFAULT_TARGET_TRIPLE);
+    }
+    
+    // Functions with loops are the ones worth compiling more than once
+    std::vector<llvm::Function*> hotFunctions;
+    for (llvm::Function& function : *module) {
+        if (functionsWithLoops.count(&function)) {
+            hotFunctions.push_back(&function);
+        }
+    }
+    if (hotFunctions.empty()) {
+        return;
+    }
+    
+    // The baseline (nullptr) plus each requested level, lowest first
+    std::vector<const CloneTarget*> levels = {nullptr};
+    for (const CloneTarget& target : cloneTargets) {
+        if (std::find(targetClones.begin(), targetClones.end(), target.name) != targetClones.end()) {
+            levels.push_back(&target);
+        }
+    }
+    
+    // Create every clone before filling any in, so calls between hot
+    // functions can go straight to the clone of the same level instead of
+    // back through the dispatcher
+    std::map<llvm::Function*, std::vector<llvm::Function*>> clones;
+    for (llvm::Function* function : hotFunctions) {
+        for (const CloneTarget* level : levels) {
+            std::string suffix = level ? level->name : "default";
+            clones[function].push_back(llvm::Function::Create(
+                function->getFunctionType(), llvm::Function::InternalLinkage,
+                function->getName() + "." + suffix, module.get()));
+        }
+    }
+    
+    for (size_t i = 0; i < levels.size(); i++) {
+        for (llvm::Function* function : hotFunctions) {
+            llvm::Function* clone = clones[function][i];
+            
+            llvm::ValueToValueMapTy valueMap;
+            for (llvm::Function* callee : hotFunctions) {
+                valueMap[callee] = clones[callee][i];
+            }
+            auto cloneArg = clone->arg_begin();
+            for (llvm::Argument& arg : function->args()) {
+                cloneArg->setName(arg.getName());
+                valueMap[&arg] = &*cloneArg++;
+            }
+            
+            llvm::SmallVector<llvm::ReturnInst*, 4> returns;
+            llvm::CloneFunctionInto(clone, function, valueMap,
+                                    llvm::CloneFunctionChangeType::LocalChangesOnly, returns);
+            clone->setLinkage(llvm::GlobalValue::InternalLinkage);
+            if (levels[i]) {
+                clone->addFnAttr("target-features", levels[i]->features);
+            }
+        }
+    }
+    
+    // Replace each original with an ifunc whose resolver picks the best
+    // clone for the CPU once, when the program is loaded
+    llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+    llvm::Function* cpuLevelFunc = declareRuntimeFunction("twine_cpu_level", llvm::Type::getInt32Ty(*context), {});
+    for (llvm::Function* function : hotFunctions) {
+        llvm::Function* resolver = llvm::Function::Create(
+            llvm::FunctionType::get(ptrType, false), llvm::Function::InternalLinkage,
+            function->getName() + ".resolver", module.get());
+        llvm::IRBuilder<> resolverBuilder(llvm::BasicBlock::Create(*context, "entry", resolver));
+        
+        llvm::Value* cpuLevel = resolverBuilder.CreateCall(cpuLevelFunc, {}, "level");
+        llvm::Value* chosen = clones[function][0];
+        for (size_t i = 1; i < levels.size(); i++) {
+            llvm::Value* supported = resolverBuilder.CreateICmpUGE(cpuLevel, getInt32(levels[i]->cpuLevel));
+            chosen = resolverBuilder.CreateSelect(supported, clones[function][i], chosen);
+        }
+        resolverBuilder.CreateRet(chosen);
+        
+        llvm::GlobalIFunc* dispatcher = llvm::GlobalIFunc::create(
+            function->getFunctionType(), function->getAddressSpace(), function->getLinkage(),
+            "", resolver, module.get());
+        dispatcher->takeName(function);
+        function->replaceAllUsesWith(dispatcher);
+        
+        for (auto& entry : functions) {
+            if (entry.second == function) entry.second = nullptr;
+        }
+        function->eraseFromParent();
+    }
+}
+
 void CodeGenerator::dumpIR() {
     module->print(llvm::outs(), nullptr);
 }
@@ -1028,26 +1622,34 @@ void CodeGenerator::visit(NumberLiteral* node) {
 }
 
 void CodeGenerator::visit(StringLiteral* node) {
-    llvm::Constant* strConstant = llvm::ConstantDataArray::getString(*context, node->value);
-    
-    llvm::GlobalVariable* globalStr = new llvm::GlobalVariable(
-        *module,
-        strConstant->getType(),
-        true,
-        llvm::GlobalValue::PrivateLinkage,
-        strConstant,
-        ".str"
-    );
-    
-    std::vector<llvm::Value*> indices = {getInt32(0), getInt32(0)};
-    llvm::Value* strPtr = builder->CreateInBoundsGEP(
-        globalStr->getValueType(),
-        globalStr,
-        indices,
-        "str"
-    );
+    // Each distinct literal gets a slot that starts out pointing at its
+    // constant text and is replaced by the interned copy before main runs
+    llvm::GlobalVariable*& slot = internedLiterals[node->value];
+    if (!slot) {
+        llvm::Constant* strConstant = llvm::ConstantDataArray::getString(*context, node->value);
+        
+        llvm::GlobalVariable* globalStr = new llvm::GlobalVariable(
+            *module,
+            strConstant->getType(),
+            true,
+            llvm::GlobalValue::PrivateLinkage,
+            strConstant,
+            ".str"
+        );
+        
+        slot = new llvm::GlobalVariable(
+            *module,
+            llvm::PointerType::getUnqual(*context),
+            false,
+            llvm::GlobalValue::InternalLinkage,
+            globalStr,
+            ".str.interned"
+        );
+    }
     
-    valueStack.push(strPtr);
+    llvm::Value* str = builder->CreateLoad(llvm::PointerType::getUnqual(*context), slot, "str");
+    tagAccess(str, "interned literal");
+    valueStack.push(str);
 }
 
 void CodeGenerator::visit(BooleanLiteral* node) {
@@ -1066,18 +1668,55 @@ void CodeGenerator::visit(Identifier* node) {
     valueStack.push(value);
 }
 
-void CodeGenerator::visit(BinaryExpression* node) {
-    node->left->accept(this);
-    llvm::Value* left = valueStack.top();
-    valueStack.pop();
+// Operators that work on the i64 value of their operands
+static bool isIntegerOperator(const std::string& op) {
+    return op == "&" || op == "|" || op == "^" || op == "<<" || op == ">>" || op == ">>>";
+}
+
+llvm::Value* CodeGenerator::createIntegerExpression(Expression* expr) {
+    // Bitwise subexpressions stay in i64, so `(h ^ x) << 5` converts each
+    // leaf once and never rounds an intermediate through a double
+    auto* binary = dynamic_cast<BinaryExpression*>(expr);
+    if (binary && isIntegerOperator(binary->op)) {
+        llvm::Value* left = createIntegerExpression(binary->left.get());
+        llvm::Value* right = createIntegerExpression(binary->right.get());
+        if (binary->op == "&") return builder->CreateAnd(left, right, "and");
+        if (binary->op == "|") return builder->CreateOr(left, right, "or");
+        if (binary->op == "^") return builder->CreateXor(left, right, "xor");
+        
+        // Shift counts wrap at 64, as on x86, instead of being undefined
+        right = builder->CreateAnd(right, getInt64(63));
+        if (binary->op == "<<") return builder->CreateShl(left, right, "shl");
+        if (binary->op == ">>") return builder->CreateAShr(left, right, "shr");
+        return builder->CreateLShr(left, right, "ushr");
+    }
+    auto* unary = dynamic_cast<UnaryExpression*>(expr);
+    if (unary && unary->op == "~") {
+        return builder->CreateNot(createIntegerExpression(unary->operand.get()), "not");
+    }
     
-    node->right->accept(this);
-    llvm::Value* right = valueStack.top();
+    expr->accept(this);
+    llvm::Value* value = convertToDouble(valueStack.top());
     valueStack.pop();
-    
+    return toInt64(value);
+}
+
+llvm::Value* CodeGenerator::toInt64(llvm::Value* value) {
+    // Truncates toward zero; NaN becomes 0 and out-of-range values clamp
+    llvm::Type* int64Type = llvm::Type::getInt64Ty(*context);
+    return builder->CreateIntrinsic(llvm::Intrinsic::fptosi_sat, {int64Type, value->getType()}, {value});
+}
+
+llvm::Value* CodeGenerator::toCount(llvm::Value* value) {
+    // Element counts: truncated like toInt64, with negatives and NaN as 0
+    return builder->CreateBinaryIntrinsic(llvm::Intrinsic::smax, toInt64(value), getInt64(0), nullptr, "count");
+}
+
+// + - * / ~/ % on two values; + concatenates when either side is a string
+llvm::Value* CodeGenerator::createArithmetic(const std::string& op, llvm::Value* left, llvm::Value* right) {
     llvm::Value* result = nullptr;
     
-    if (node->op == "+") {
+    if (op == "+") {
         if (left->getType()->isPointerTy() || right->getType()->isPointerTy()) {
             result = createStringConcatenation(left, right);
         } else if (left->getType()->isDoubleTy() || right->getType()->isDoubleTy()) {
@@ -1087,7 +1726,7 @@ void CodeGenerator::visit(BinaryExpression* node) {
         } else {
             result = builder->CreateAdd(left, right, "add");
         }
-    } else if (node->op == "-") {
+    } else if (op == "-") {
         if (left->getType()->isDoubleTy() || right->getType()->isDoubleTy()) {
             left = convertToDouble(left);
             right = convertToDouble(right);
@@ -1095,7 +1734,7 @@ void CodeGenerator::visit(BinaryExpression* node) {
         } else {
             result = builder->CreateSub(left, right, "sub");
         }
-    } else if (node->op == "*") {
+    } else if (op == "*") {
         if (left->getType()->isDoubleTy() || right->getType()->isDoubleTy()) {
             left = convertToDouble(left);
             right = convertToDouble(right);
@@ -1103,11 +1742,27 @@ void CodeGenerator::visit(BinaryExpression* node) {
         } else {
             result = builder->CreateMul(left, right, "mul");
         }
-    } else if (node->op == "/") {
+    } else if (op == "/") {
         left = convertToDouble(left);
         right = convertToDouble(right);
         result = builder->CreateFDiv(left, right, "div");
-    } else if (node->op == "%") {
+    } else if (op == "~/") {
+        // Integer division, truncating, exact on the full i64 range.
+        // A divisor that truncates to zero gives what / by zero does (inf
+        // or nan), and the one overflowing case, INT64_MIN ~/ -1, wraps
+        // instead of trapping.
+        llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+        llvm::Value* dividend = toInt64(convertToDouble(left));
+        llvm::Value* divisor = toInt64(convertToDouble(right));
+        llvm::Value* isZero = builder->CreateICmpEQ(divisor, getInt64(0));
+        llvm::Value* isMinusOne = builder->CreateICmpEQ(divisor, getInt64(-1));
+        llvm::Value* safeDivisor = builder->CreateSelect(builder->CreateOr(isZero, isMinusOne), getInt64(1), divisor);
+        llvm::Value* quotient = builder->CreateSDiv(dividend, safeDivisor);
+        quotient = builder->CreateSelect(isMinusOne, builder->CreateNeg(dividend), quotient, "idiv");
+        llvm::Value* byZero = builder->CreateFDiv(builder->CreateSIToFP(dividend, doubleType),
+                                                  llvm::ConstantFP::get(doubleType, 0.0));
+        result = builder->CreateSelect(isZero, byZero, builder->CreateSIToFP(quotient, doubleType));
+    } else if (op == "%") {
         if (left->getType()->isDoubleTy() || right->getType()->isDoubleTy()) {
             left = convertToDouble(left);
             right = convertToDouble(right);
@@ -1115,6 +1770,48 @@ void CodeGenerator::visit(BinaryExpression* node) {
         } else {
             result = builder->CreateSRem(left, right, "mod");
         }
+    }
+    
+    return result;
+}
+
+void CodeGenerator::visit(BinaryExpression* node) {
+    if (isIntegerOperator(node->op)) {
+        valueStack.push(builder->CreateSIToFP(createIntegerExpression(node), llvm::Type::getDoubleTy(*context)));
+        return;
+    }
+    
+    node->left->accept(this);
+    llvm::Value* left = valueStack.top();
+    valueStack.pop();
+    
+    node->right->accept(this);
+    llvm::Value* right = valueStack.top();
+    valueStack.pop();
+    
+    llvm::Value* result = nullptr;
+    
+    // Pointers compare by content unless one side is known to be an array,
+    // a map or null. twine_str_eq checks pointer equality first, so two
+    // interned strings still compare in O(1).
+    auto comparesByIdentity = [this](Expression* expr) {
+        ValueKind kind = expressionKind(expr);
+        return isArrayKind(kind) || kind == ValueKind::Map ||
+               dynamic_cast<NullLiteral*>(expr) != nullptr;
+    };
+    bool isStringComparison = (node->op == "==" || node->op == "!=") &&
+        left->getType()->isPointerTy() && right->getType()->isPointerTy() &&
+        !comparesByIdentity(node->left.get()) && !comparesByIdentity(node->right.get());
+    
+    if (isStringComparison) {
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Function* eqFunc = declareRuntimeFunction("twine_str_eq", llvm::Type::getInt32Ty(*context), {ptrType, ptrType});
+        llvm::Value* equal = builder->CreateCall(eqFunc, {left, right});
+        result = node->op == "==" ? builder->CreateICmpNE(equal, getInt32(0), "eq")
+                                  : builder->CreateICmpEQ(equal, getInt32(0), "ne");
+    } else if (node->op == "+" || node->op == "-" || node->op == "*" || node->op == "/" || node->op == "~/" ||
+               node->op == "%") {
+        result = createArithmetic(node->op, left, right);
     } else if (node->op == "==") {
         if (left->getType()->isDoubleTy() || right->getType()->isDoubleTy()) {
             left = convertToDouble(left);
@@ -1181,6 +1878,11 @@ void CodeGenerator::visit(BinaryExpression* node) {
 }
 
 void CodeGenerator::visit(UnaryExpression* node) {
+    if (node->op == "~") {
+        valueStack.push(builder->CreateSIToFP(createIntegerExpression(node), llvm::Type::getDoubleTy(*context)));
+        return;
+    }
+    
     node->operand->accept(this);
     llvm::Value* operand = valueStack.top();
     valueStack.pop();
@@ -1205,12 +1907,103 @@ void CodeGenerator::visit(UnaryExpression* node) {
     }
 }
 
+bool CodeGenerator::isSpeculatable(Expression* expr, int& budget) {
+    // Small trees of loads, literals and number arithmetic: safe and cheap
+    // to evaluate even when their value ends up unused. Indexing is left
+    // out because the condition may be what keeps the index in bounds.
+    if (--budget < 0) {
+        return false;
+    } else if (dynamic_cast<NumberLiteral*>(expr) || dynamic_cast<BooleanLiteral*>(expr) ||
+               dynamic_cast<StringLiteral*>(expr) || dynamic_cast<Identifier*>(expr)) {
+        return true;
+    } else if (auto* unary = dynamic_cast<UnaryExpression*>(expr)) {
+        return isSpeculatable(unary->operand.get(), budget);
+    } else if (auto* binary = dynamic_cast<BinaryExpression*>(expr)) {
+        // String + and == call into the runtime
+        return expressionKind(binary->left.get()) == ValueKind::Number &&
+               expressionKind(binary->right.get()) == ValueKind::Number &&
+               isSpeculatable(binary->left.get(), budget) && isSpeculatable(binary->right.get(), budget);
+    } else if (auto* conditional = dynamic_cast<ConditionalExpression*>(expr)) {
+        return isSpeculatable(conditional->condition.get(), budget) &&
+               isSpeculatable(conditional->thenValue.get(), budget) &&
+               isSpeculatable(conditional->elseValue.get(), budget);
+    }
+    return false;
+}
+
+void CodeGenerator::visit(ConditionalExpression* node) {
+    node->condition->accept(this);
+    llvm::Value* condition = convertToBool(valueStack.top());
+    valueStack.pop();
+    
+    // Both arms must end up with one type: numbers and booleans meet as
+    // doubles, and a number meeting a pointer is boxed
+    auto unify = [&](llvm::Value* value, llvm::Type* otherType) {
+        if (value->getType() == otherType) return value;
+        if (value->getType()->isPointerTy()) return value;
+        if (otherType->isPointerTy()) return boxValue(convertToDouble(value));
+        return convertToDouble(value);
+    };
+    
+    int budget = 8;
+    if (isSpeculatable(node->thenValue.get(), budget) && isSpeculatable(node->elseValue.get(), budget)) {
+        // Cheap arms are both computed and picked with a select, which
+        // becomes a cmov or blend rather than a branch
+        node->thenValue->accept(this);
+        llvm::Value* thenValue = valueStack.top();
+        valueStack.pop();
+        node->elseValue->accept(this);
+        llvm::Value* elseValue = valueStack.top();
+        valueStack.pop();
+        
+        llvm::Type* thenType = thenValue->getType();
+        thenValue = unify(thenValue, elseValue->getType());
+        elseValue = unify(elseValue, thenType);
+        valueStack.push(builder->CreateSelect(condition, thenValue, elseValue, "cond"));
+        return;
+    }
+    
+    llvm::Function* function = builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock* thenBlock = llvm::BasicBlock::Create(*context, "cond.then", function);
+    llvm::BasicBlock* elseBlock = llvm::BasicBlock::Create(*context, "cond.else", function);
+    llvm::BasicBlock* mergeBlock = llvm::BasicBlock::Create(*context, "cond.merge", function);
+    builder->CreateCondBr(condition, thenBlock, elseBlock);
+    
+    builder->SetInsertPoint(thenBlock);
+    node->thenValue->accept(this);
+    llvm::Value* thenValue = valueStack.top();
+    valueStack.pop();
+    llvm::BasicBlock* thenEnd = builder->GetInsertBlock();
+    
+    builder->SetInsertPoint(elseBlock);
+    node->elseValue->accept(this);
+    llvm::Value* elseValue = valueStack.top();
+    valueStack.pop();
+    
+    // Conversions happen at the end of each arm, once both types are known
+    llvm::Type* thenType = thenValue->getType();
+    elseValue = unify(elseValue, thenType);
+    llvm::BasicBlock* elseEnd = builder->GetInsertBlock();
+    builder->CreateBr(mergeBlock);
+    
+    builder->SetInsertPoint(thenEnd);
+    thenValue = unify(thenValue, elseValue->getType());
+    builder->CreateBr(mergeBlock);
+    
+    builder->SetInsertPoint(mergeBlock);
+    llvm::PHINode* result = builder->CreatePHI(thenValue->getType(), 2, "cond");
+    result->addIncoming(thenValue, thenEnd);
+    result->addIncoming(elseValue, elseEnd);
+    valueStack.push(result);
+}
+
 void CodeGenerator::visit(AssignmentExpression* node) {
     node->value->accept(this);
     llvm::Value* value = valueStack.top();
     valueStack.pop();
     
     setVariable(node->name, value);
+    recordVariableKind(node->name, expressionKind(node->value.get()));
     valueStack.push(value);
 }
 
@@ -1220,91 +2013,25 @@ void CodeGenerator::visit(CallExpression* node) {
             std::cerr << "Warning: input() function takes no arguments, ignoring provided arguments" << std::endl;
         }
         
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Function* inputFunc = declareRuntimeFunction("twine_input", ptrType, {});
+        valueStack.push(builder->CreateCall(inputFunc, {}));
+        return;
+    } else if (node->name == "str") {
+        if (node->arguments.size() != 1) {
+            std::cerr << "Error: str() expects exactly 1 argument" << std::endl;
+            return;
+        }
+        node->arguments[0]->accept(this);
+        llvm::Value* value = valueStack.top();
+        valueStack.pop();
+        
+        if (!value->getType()->isDoubleTy()) {
+            value = convertToDouble(value);
+        }
         llvm::Type* charType = llvm::Type::getInt8Ty(*context);
-        llvm::Type* arrayType = llvm::ArrayType::get(charType, 1024);
-        llvm::AllocaInst* buffer = builder->CreateAlloca(arrayType, nullptr, "input_buffer");
-        
-        std::vector<llvm::Value*> indices = {
-            llvm::ConstantInt::get(*context, llvm::APInt(32, 0)),
-            llvm::ConstantInt::get(*context, llvm::APInt(32, 0))
-        };
-        llvm::Value* bufferPtr = builder->CreateInBoundsGEP(
-            arrayType,
-            buffer,
-            indices
-        );
-        
-        llvm::Value* stdinPtr;
-#ifdef _WIN32
-        llvm::Function* getStdinFunc = module->getFunction("get_stdin_ptr");
-        if (!getStdinFunc) {
-            // Recreate the helper if it doesn't exist
-            declareStdin();
-            getStdinFunc = module->getFunction("get_stdin_ptr");
-        }
-        stdinPtr = builder->CreateCall(getStdinFunc, {}, "stdin_ptr");
-#else
-        llvm::GlobalVariable* stdinVar = module->getGlobalVariable("stdin");
-        if (!stdinVar) {
-            stdinVar = declareStdin();
-        }
-        stdinPtr = builder->CreateLoad(llvm::PointerType::getUnqual(*context), stdinVar, "stdin_load");
-#endif
-        
-        llvm::Value* bufferSize = llvm::ConstantInt::get(*context, llvm::APInt(32, 1024));
-        llvm::Value* result = builder->CreateCall(functions["fgets"], {bufferPtr, bufferSize, stdinPtr});
-        
-        llvm::Function* strlenFunc = module->getFunction("strlen");
-        if (!strlenFunc) {
-            llvm::FunctionType* strlenType = llvm::FunctionType::get(
-                llvm::Type::getInt64Ty(*context),
-                {llvm::PointerType::getUnqual(*context)},
-                false
-            );
-            strlenFunc = llvm::Function::Create(
-                strlenType,
-                llvm::Function::ExternalLinkage,
-                "strlen",
-                module.get()
-            );
-        }
-        
-        llvm::Value* length = builder->CreateCall(strlenFunc, {bufferPtr});
-        
-        llvm::Value* one = llvm::ConstantInt::get(*context, llvm::APInt(64, 1));
-        llvm::Value* lastCharIndex = builder->CreateSub(length, one);
-        llvm::Value* lastCharPtr = builder->CreateInBoundsGEP(charType, bufferPtr, lastCharIndex);
-        llvm::Value* lastChar = builder->CreateLoad(charType, lastCharPtr);
-        llvm::Value* newline = llvm::ConstantInt::get(charType, 10);
-        llvm::Value* isNewline = builder->CreateICmpEQ(lastChar, newline);
-        llvm::BasicBlock* thenBlock = llvm::BasicBlock::Create(*context, "remove_newline", currentFunction);
-        llvm::BasicBlock* mergeBlock = llvm::BasicBlock::Create(*context, "merge", currentFunction);
-        
-        builder->CreateCondBr(isNewline, thenBlock, mergeBlock);
-        
-        builder->SetInsertPoint(thenBlock);
-        llvm::Value* nullChar = llvm::ConstantInt::get(charType, 0);
-        builder->CreateStore(nullChar, lastCharPtr);
-        builder->CreateBr(mergeBlock);
-        
-        builder->SetInsertPoint(mergeBlock);
-        valueStack.push(bufferPtr);
-        return;
-    } else if (node->name == "str") {
-        if (node->arguments.size() != 1) {
-            std::cerr << "Error: str() expects exactly 1 argument" << std::endl;
-            return;
-        }
-        node->arguments[0]->accept(this);
-        llvm::Value* value = valueStack.top();
-        valueStack.pop();
-        
-        if (!value->getType()->isDoubleTy()) {
-            value = convertToDouble(value);
-        }
-        llvm::Type* charType = llvm::Type::getInt8Ty(*context);
-        llvm::Type* arrayType = llvm::ArrayType::get(charType, 32);
-        llvm::AllocaInst* buffer = builder->CreateAlloca(arrayType, nullptr, "str_buffer");
+        llvm::Type* arrayType = llvm::ArrayType::get(charType, 32);
+        llvm::AllocaInst* buffer = builder->CreateAlloca(arrayType, nullptr, "str_buffer");
         
         std::vector<llvm::Value*> indices = {
             llvm::ConstantInt::get(*context, llvm::APInt(32, 0)),
@@ -1399,7 +2126,7 @@ void CodeGenerator::visit(CallExpression* node) {
         }
         
         if (node->arguments.size() == 1) {
-            llvm::Value* result = builder->CreateCall(functions["mathRound"], {value});
+            llvm::Value* result = createMathCall(functions["mathRound"], {value});
             valueStack.push(result);
         } else {
             node->arguments[1]->accept(this);
@@ -1410,10 +2137,10 @@ void CodeGenerator::visit(CallExpression* node) {
                 decimalPlaces = convertToDouble(decimalPlaces);
             }
             llvm::Value* ten = llvm::ConstantFP::get(*context, llvm::APFloat(10.0));
-            llvm::Value* scaleFactor = builder->CreateCall(functions["mathPow"], {ten, decimalPlaces});
+            llvm::Value* scaleFactor = createMathCall(functions["mathPow"], {ten, decimalPlaces});
             
             llvm::Value* scaled = builder->CreateFMul(value, scaleFactor);
-            llvm::Value* roundedScaled = builder->CreateCall(functions["mathRound"], {scaled});
+            llvm::Value* roundedScaled = createMathCall(functions["mathRound"], {scaled});
             llvm::Value* result = builder->CreateFDiv(roundedScaled, scaleFactor);
             
             valueStack.push(result);
@@ -1495,7 +2222,7 @@ void CodeGenerator::visit(CallExpression* node) {
             exponent = convertToDouble(exponent);
         }
         
-        llvm::Value* result = builder->CreateCall(functions["mathPow"], {base, exponent});
+        llvm::Value* result = createMathCall(functions["mathPow"], {base, exponent});
         valueStack.push(result);
         return;
     } else if (node->name == "sqrt") {
@@ -1511,7 +2238,7 @@ void CodeGenerator::visit(CallExpression* node) {
             value = convertToDouble(value);
         }
         
-        llvm::Value* result = builder->CreateCall(functions["mathSqrt"], {value});
+        llvm::Value* result = createMathCall(functions["mathSqrt"], {value});
         valueStack.push(result);
         return;
     } else if (node->name == "floor") {
@@ -1528,7 +2255,7 @@ void CodeGenerator::visit(CallExpression* node) {
             value = convertToDouble(value);
         }
         
-        llvm::Value* result = builder->CreateCall(functions["mathFloor"], {value});
+        llvm::Value* result = createMathCall(functions["mathFloor"], {value});
         valueStack.push(result);
         return;
     } else if (node->name == "ceil") {
@@ -1545,7 +2272,7 @@ void CodeGenerator::visit(CallExpression* node) {
             value = convertToDouble(value);
         }
         
-        llvm::Value* result = builder->CreateCall(functions["mathCeil"], {value});
+        llvm::Value* result = createMathCall(functions["mathCeil"], {value});
         valueStack.push(result);
         return;
     } else if (node->name == "sin") {
@@ -1561,7 +2288,7 @@ void CodeGenerator::visit(CallExpression* node) {
             value = convertToDouble(value);
         }
         
-        llvm::Value* result = builder->CreateCall(functions["mathSin"], {value});
+        llvm::Value* result = createMathCall(functions["mathSin"], {value});
         valueStack.push(result);
         return;
     } else if (node->name == "cos") {
@@ -1577,7 +2304,7 @@ void CodeGenerator::visit(CallExpression* node) {
             value = convertToDouble(value);
         }
         
-        llvm::Value* result = builder->CreateCall(functions["mathCos"], {value});
+        llvm::Value* result = createMathCall(functions["mathCos"], {value});
         valueStack.push(result);
         return;
     } else if (node->name == "tan") {
@@ -1593,110 +2320,16 @@ void CodeGenerator::visit(CallExpression* node) {
             value = convertToDouble(value);
         }
         
-        llvm::Value* result = builder->CreateCall(functions["mathTan"], {value});
+        llvm::Value* result = createMathCall(functions["mathTan"], {value});
         valueStack.push(result);
         return;
     } else if (node->name == "random") {
         if (!node->arguments.empty()) {
             std::cerr << "Warning: random() function takes no arguments, ignoring provided arguments" << std::endl;
         }
-        llvm::GlobalVariable* stateVar = module->getGlobalVariable("_random_state");
-        if (!stateVar) {
-            stateVar = new llvm::GlobalVariable(
-                *module,
-                llvm::Type::getInt64Ty(*context),
-                false,
-                llvm::GlobalValue::InternalLinkage,
-                llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1),
-                "_random_state"
-            );
-        }
-        llvm::GlobalVariable* seededVar = module->getGlobalVariable("_random_seeded");
-        if (!seededVar) {
-            seededVar = new llvm::GlobalVariable(
-                *module,
-                llvm::Type::getInt1Ty(*context),
-                false,
-                llvm::GlobalValue::InternalLinkage,
-                llvm::ConstantInt::get(llvm::Type::getInt1Ty(*context), 0),
-                "_random_seeded"
-            );
-        }
-        llvm::Value* alreadySeeded = builder->CreateLoad(
-            llvm::Type::getInt1Ty(*context), 
-            seededVar, 
-            "seeded_check"
-        );
-        
-        llvm::BasicBlock* seedBlock = llvm::BasicBlock::Create(*context, "seed_random", currentFunction);
-        llvm::BasicBlock* skipSeedBlock = llvm::BasicBlock::Create(*context, "skip_seed", currentFunction);
-        llvm::BasicBlock* afterSeedBlock = llvm::BasicBlock::Create(*context, "after_seed", currentFunction);
-        
-        builder->CreateCondBr(alreadySeeded, skipSeedBlock, seedBlock);
-        
-        builder->SetInsertPoint(seedBlock);
-        if (!module->getFunction("time")) {
-            std::vector<llvm::Type*> timeParams = {
-                llvm::PointerType::getUnqual(*context) // time_t *
-            };
-            
-            llvm::FunctionType* timeType = llvm::FunctionType::get(
-                llvm::Type::getInt64Ty(*context),
-                timeParams,
-                false
-            );
-            
-            llvm::Function::Create(
-                timeType,
-                llvm::Function::ExternalLinkage,
-                "time",
-                module.get()
-            );
-        }
-        
-        llvm::Value* nullPtr = llvm::ConstantPointerNull::get(llvm::PointerType::getUnqual(*context));
-        llvm::Value* currentTime = builder->CreateCall(module->getFunction("time"), {nullPtr});
-        llvm::AllocaInst* localVar = builder->CreateAlloca(llvm::Type::getInt32Ty(*context), nullptr, "entropy");
-        llvm::Value* stackAddr = builder->CreatePtrToInt(localVar, llvm::Type::getInt64Ty(*context));
-        llvm::Value* multiplier1 = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1103515245ULL);
-        llvm::Value* multiplier2 = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 12345ULL);
-        llvm::Value* increment = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1);
-        llvm::Value* shift16 = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 16);
-        
-        llvm::Value* timePart = builder->CreateMul(currentTime, multiplier1);
-        llvm::Value* addrPart = builder->CreateMul(stackAddr, multiplier2);
-        llvm::Value* combined = builder->CreateAdd(timePart, addrPart);
-        combined = builder->CreateAdd(combined, increment);
-        
-        llvm::Value* addrShifted = builder->CreateLShr(stackAddr, shift16);
-        llvm::Value* finalSeed = builder->CreateXor(combined, addrShifted);
-        
-        builder->CreateStore(finalSeed, stateVar);
-        builder->CreateStore(llvm::ConstantInt::get(llvm::Type::getInt1Ty(*context), 1), seededVar);
-        
-        builder->CreateBr(afterSeedBlock);
-        
-        builder->SetInsertPoint(skipSeedBlock);
-        builder->CreateBr(afterSeedBlock);
-        
-        builder->SetInsertPoint(afterSeedBlock);
-        llvm::Value* state = builder->CreateLoad(llvm::Type::getInt64Ty(*context), stateVar, "current_state");
-        llvm::Value* a = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1664525ULL);
-        llvm::Value* c = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1013904223ULL);
-        
-        llvm::Value* nextState = builder->CreateMul(state, a);
-        nextState = builder->CreateAdd(nextState, c);
-        
-        builder->CreateStore(nextState, stateVar);
-        llvm::Value* shift32 = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 32);
-        llvm::Value* upperBits = builder->CreateLShr(nextState, shift32);
-        llvm::Value* randInt = builder->CreateTrunc(upperBits, llvm::Type::getInt32Ty(*context));
         
-        llvm::Value* randDouble = builder->CreateUIToFP(randInt, llvm::Type::getDoubleTy(*context));
-        
-        llvm::Value* divisor = llvm::ConstantFP::get(*context, llvm::APFloat(4294967296.0));
-        llvm::Value* result = builder->CreateFDiv(randDouble, divisor);
-        valueStack.push(result);
+        llvm::Function* randomFunc = declareRuntimeFunction("twine_random", llvm::Type::getDoubleTy(*context), {});
+        valueStack.push(builder->CreateCall(randomFunc, {}));
         return;
     } else if (node->name == "len") {
         if (node->arguments.size() != 1) {
@@ -1710,48 +2343,21 @@ void CodeGenerator::visit(CallExpression* node) {
         if (!value->getType()->isPointerTy()) {
             throw std::runtime_error("len() expects a string or array argument");
         }
-        llvm::Type* elementType = llvm::Type::getDoubleTy(*context);
-        llvm::Value* sizePtr = builder->CreateInBoundsGEP(elementType, value,
-            llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), -1));
-        
-        llvm::BasicBlock* arrayBlock = llvm::BasicBlock::Create(*context, "is_array", currentFunction);
-        llvm::BasicBlock* stringBlock = llvm::BasicBlock::Create(*context, "is_string", currentFunction);
-        llvm::BasicBlock* mergeBlock = llvm::BasicBlock::Create(*context, "len_merge", currentFunction);
-        
-        llvm::Value* firstByte = builder->CreateLoad(llvm::Type::getInt8Ty(*context), 
-            builder->CreateBitCast(value, llvm::PointerType::getUnqual(llvm::Type::getInt8Ty(*context))));
-        llvm::Value* isPrintable = builder->CreateAnd(
-            builder->CreateICmpUGE(firstByte, llvm::ConstantInt::get(llvm::Type::getInt8Ty(*context), 32)),
-            builder->CreateICmpULE(firstByte, llvm::ConstantInt::get(llvm::Type::getInt8Ty(*context), 126))
-        );
         
-        builder->CreateCondBr(isPrintable, stringBlock, arrayBlock);
-        
-        builder->SetInsertPoint(arrayBlock);
-        llvm::Value* arraySize = builder->CreateLoad(elementType, sizePtr);
-        builder->CreateBr(mergeBlock);
-        
-        builder->SetInsertPoint(stringBlock);
-        llvm::Function* strlenFunc = module->getFunction("strlen");
-        if (!strlenFunc) {
-            declareStrlen();
-            strlenFunc = module->getFunction("strlen");
+        // Arrays known statically read the count slot directly
+        ValueKind kind = expressionKind(node->arguments[0].get());
+        if (isArrayKind(kind)) {
+            valueStack.push(builder->CreateUIToFP(loadArrayCount(value), llvm::Type::getDoubleTy(*context)));
+            return;
         }
-        llvm::Value* strLength = builder->CreateCall(strlenFunc, {value});
-        llvm::Value* strLengthDouble = builder->CreateUIToFP(strLength, elementType);
-        builder->CreateBr(mergeBlock);
         
-        builder->SetInsertPoint(mergeBlock);
-        llvm::PHINode* result = builder->CreatePHI(elementType, 2);
-        result->addIncoming(arraySize, arrayBlock);
-        result->addIncoming(strLengthDouble, stringBlock);
-        
-        valueStack.push(result);
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Function* lenFunc = declareRuntimeFunction("twine_len", llvm::Type::getDoubleTy(*context), {ptrType});
+        valueStack.push(builder->CreateCall(lenFunc, {value}));
         return;
-    } else if (node->name == "upper") {
-        // Handle upper specially - converts string to uppercase
+    } else if (node->name == "upper" || node->name == "lower" || node->name == "intern") {
         if (node->arguments.size() != 1) {
-            throw std::runtime_error("upper() expects exactly 1 argument");
+            throw std::runtime_error(node->name + "() expects exactly 1 argument");
         }
         
         node->arguments[0]->accept(this);
@@ -1759,418 +2365,566 @@ void CodeGenerator::visit(CallExpression* node) {
         valueStack.pop();
         
         if (!value->getType()->isPointerTy()) {
-            throw std::runtime_error("upper() expects a string argument");
+            throw std::runtime_error(node->name + "() expects a string argument");
         }
         
-        llvm::Function* strlenFunc = module->getFunction("strlen");
-        if (!strlenFunc) {
-            declareStrlen();
-            strlenFunc = module->getFunction("strlen");
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Function* stringFunc = declareRuntimeFunction("twine_" + node->name, ptrType, {ptrType});
+        valueStack.push(builder->CreateCall(stringFunc, {value}));
+        return;
+    } else if (node->name == "includes" || node->name == "indexOf") {
+        if (node->arguments.size() != 2) {
+            throw std::runtime_error(node->name + "() expects exactly 2 arguments");
         }
         
-        llvm::Value* length = builder->CreateCall(strlenFunc, {value});
+        node->arguments[0]->accept(this);
+        llvm::Value* haystack = valueStack.top();
+        valueStack.pop();
+
+        node->arguments[1]->accept(this);
+        llvm::Value* needle = valueStack.top();
+        valueStack.pop();
         
-        // Allocate memory for the result string (length + 1 for null terminator)
-        llvm::Function* mallocFunc = module->getFunction("malloc");
-        if (!mallocFunc) {
-            declareMalloc();
-            mallocFunc = module->getFunction("malloc");
+        if (!haystack->getType()->isPointerTy()) {
+            throw std::runtime_error(node->name + "() expects first argument to be a string or array");
         }
+
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+        std::string suffix = node->name == "includes" ? "includes" : "index_of";
         
-        llvm::Value* lengthPlus1 = builder->CreateAdd(length, 
-            llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1));
-        llvm::Value* resultBuffer = builder->CreateCall(mallocFunc, {lengthPlus1});
-        
-        llvm::BasicBlock* loopCondBlock = llvm::BasicBlock::Create(*context, "loop_cond", currentFunction);
-        llvm::BasicBlock* loopBodyBlock = llvm::BasicBlock::Create(*context, "loop_body", currentFunction);
-        llvm::BasicBlock* loopEndBlock = llvm::BasicBlock::Create(*context, "loop_end", currentFunction);
-        
-        llvm::AllocaInst* indexVar = builder->CreateAlloca(llvm::Type::getInt64Ty(*context), nullptr, "index");
-        builder->CreateStore(llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 0), indexVar);
+        if (needle->getType()->isPointerTy()) {
+            llvm::Function* searchFunc = declareRuntimeFunction("twine_str_" + suffix, doubleType, {ptrType, ptrType});
+            valueStack.push(builder->CreateCall(searchFunc, {haystack, needle}));
+        } else {
+            needle = convertToDouble(needle);
+            llvm::Function* searchFunc = declareRuntimeFunction("twine_array_" + suffix, doubleType, {ptrType, doubleType});
+            valueStack.push(builder->CreateCall(searchFunc, {haystack, needle}));
+        }
+        return;
+    } else if (node->name == "sum" || node->name == "mean" || node->name == "variance" ||
+               node->name == "prod" || node->name == "minOf" || node->name == "maxOf") {
+        // sum, mean and variance take an optional flag selecting the stable
+        // (pairwise) summation mode
+        bool hasStableMode = node->name == "sum" || node->name == "mean" || node->name == "variance";
+        size_t maxArgs = hasStableMode ? 2 : 1;
+        if (node->arguments.empty() || node->arguments.size() > maxArgs) {
+            throw std::runtime_error(node->name + (hasStableMode ? "() expects 1 or 2 arguments" : "() expects exactly 1 argument"));
+        }
         
-        builder->CreateBr(loopCondBlock);
+        if (CallExpression* range = asRangeCall(node->arguments[0].get())) {
+            valueStack.push(createRangeReduction(node, range));
+            return;
+        }
         
-        // index < length
-        builder->SetInsertPoint(loopCondBlock);
-        llvm::Value* currentIndex = builder->CreateLoad(llvm::Type::getInt64Ty(*context), indexVar, "current_index");
-        llvm::Value* condition = builder->CreateICmpULT(currentIndex, length, "loop_condition");
-        builder->CreateCondBr(condition, loopBodyBlock, loopEndBlock);
+        node->arguments[0]->accept(this);
+        llvm::Value* array = valueStack.top();
+        valueStack.pop();
         
-        builder->SetInsertPoint(loopBodyBlock);
+        if (!array->getType()->isPointerTy()) {
+            throw std::runtime_error(node->name + "() expects an array argument");
+        }
         
-        llvm::Value* srcPtr = builder->CreateInBoundsGEP(llvm::Type::getInt8Ty(*context), value, currentIndex);
-        llvm::Value* srcChar = builder->CreateLoad(llvm::Type::getInt8Ty(*context), srcPtr, "src_char");
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+        static const std::map<std::string, std::string> runtimeNames = {
+            {"sum", "twine_sum"}, {"mean", "twine_mean"}, {"variance", "twine_variance"},
+            {"prod", "twine_prod"}, {"minOf", "twine_min_of"}, {"maxOf", "twine_max_of"}
+        };
+        const std::string& runtimeName = runtimeNames.at(node->name);
         
-        // Check if character is lowercase (between 'a' and 'z')
-        llvm::Value* charA = llvm::ConstantInt::get(llvm::Type::getInt8Ty(*context), 97); // 'a'
-        llvm::Value* charZ = llvm::ConstantInt::get(llvm::Type::getInt8Ty(*context), 122); // 'z'
-        llvm::Value* isLowercase = builder->CreateAnd(
-            builder->CreateICmpUGE(srcChar, charA),
-            builder->CreateICmpULE(srcChar, charZ)
-        );
+        if (hasStableMode) {
+            llvm::Value* stable = llvm::ConstantFP::get(doubleType, 0.0);
+            if (node->arguments.size() == 2) {
+                node->arguments[1]->accept(this);
+                stable = convertToDouble(valueStack.top());
+                valueStack.pop();
+            }
+            llvm::Function* reduceFunc = declareRuntimeFunction(runtimeName, doubleType, {ptrType, doubleType});
+            valueStack.push(builder->CreateCall(reduceFunc, {array, stable}));
+        } else {
+            llvm::Function* reduceFunc = declareRuntimeFunction(runtimeName, doubleType, {ptrType});
+            valueStack.push(builder->CreateCall(reduceFunc, {array}));
+        }
+        return;
+    } else if (node->name == "dot") {
+        if (node->arguments.size() != 2 && node->arguments.size() != 3) {
+            throw std::runtime_error("dot() expects 2 or 3 arguments");
+        }
         
-        // Convert to uppercase by subtracting 32 if it's lowercase
-        llvm::Value* upperOffset = llvm::ConstantInt::get(llvm::Type::getInt8Ty(*context), 32);
-        llvm::Value* upperChar = builder->CreateSub(srcChar, upperOffset);
-        llvm::Value* resultChar = builder->CreateSelect(isLowercase, upperChar, srcChar);
+        node->arguments[0]->accept(this);
+        llvm::Value* left = valueStack.top();
+        valueStack.pop();
         
-        // Store character in result buffer
-        llvm::Value* dstPtr = builder->CreateInBoundsGEP(llvm::Type::getInt8Ty(*context), resultBuffer, currentIndex);
-        builder->CreateStore(resultChar, dstPtr);
+        node->arguments[1]->accept(this);
+        llvm::Value* right = valueStack.top();
+        valueStack.pop();
         
-        llvm::Value* nextIndex = builder->CreateAdd(currentIndex, 
-            llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1));
-        builder->CreateStore(nextIndex, indexVar);
-        builder->CreateBr(loopCondBlock);
+        if (!left->getType()->isPointerTy() || !right->getType()->isPointerTy()) {
+            throw std::runtime_error("dot() expects two array arguments");
+        }
         
-        builder->SetInsertPoint(loopEndBlock);
-        llvm::Value* nullTermPtr = builder->CreateInBoundsGEP(llvm::Type::getInt8Ty(*context), resultBuffer, length);
-        builder->CreateStore(llvm::ConstantInt::get(llvm::Type::getInt8Ty(*context), 0), nullTermPtr);
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+        llvm::Value* stable = llvm::ConstantFP::get(doubleType, 0.0);
+        if (node->arguments.size() == 3) {
+            node->arguments[2]->accept(this);
+            stable = convertToDouble(valueStack.top());
+            valueStack.pop();
+        }
         
-        valueStack.push(resultBuffer);
+        llvm::Function* dotFunc = declareRuntimeFunction("twine_dot", doubleType, {ptrType, ptrType, doubleType});
+        valueStack.push(builder->CreateCall(dotFunc, {left, right, stable}));
         return;
-    } else if (node->name == "lower") {
-        // Handle lower specially - converts string to lowercase
+    } else if (node->name == "sort" || node->name == "sorted") {
         if (node->arguments.size() != 1) {
-            throw std::runtime_error("lower() expects exactly 1 argument");
+            throw std::runtime_error(node->name + "() expects exactly 1 argument");
         }
         
         node->arguments[0]->accept(this);
-        llvm::Value* value = valueStack.top();
+        llvm::Value* array = valueStack.top();
         valueStack.pop();
         
-        if (!value->getType()->isPointerTy()) {
-            throw std::runtime_error("lower() expects a string argument");
+        if (!array->getType()->isPointerTy()) {
+            throw std::runtime_error(node->name + "() expects an array argument");
         }
         
-        llvm::Function* strlenFunc = module->getFunction("strlen");
-        if (!strlenFunc) {
-            declareStrlen();
-            strlenFunc = module->getFunction("strlen");
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Function* sortFunc = declareRuntimeFunction("twine_" + node->name, ptrType, {ptrType});
+        // sort() returns its argument; sorted() returns a copy
+        valueStack.push(markArrayResult(builder->CreateCall(sortFunc, {array}), node->name == "sorted"));
+        return;
+    } else if (node->name == "searchSorted") {
+        if (node->arguments.size() != 2) {
+            throw std::runtime_error("searchSorted() expects exactly 2 arguments");
         }
         
-        llvm::Value* length = builder->CreateCall(strlenFunc, {value});
+        node->arguments[0]->accept(this);
+        llvm::Value* array = valueStack.top();
+        valueStack.pop();
         
-        // Allocate memory for the result string (length + 1 for null terminator)
-        llvm::Function* mallocFunc = module->getFunction("malloc");
-        if (!mallocFunc) {
-            declareMalloc();
-            mallocFunc = module->getFunction("malloc");
+        node->arguments[1]->accept(this);
+        llvm::Value* value = convertToDouble(valueStack.top());
+        valueStack.pop();
+        
+        if (!array->getType()->isPointerTy()) {
+            throw std::runtime_error("searchSorted() expects an array as first argument");
         }
         
-        llvm::Value* lengthPlus1 = builder->CreateAdd(length, 
-            llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1));
-        llvm::Value* resultBuffer = builder->CreateCall(mallocFunc, {lengthPlus1});
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+        llvm::Function* searchFunc = declareRuntimeFunction("twine_search_sorted", doubleType, {ptrType, doubleType});
+        valueStack.push(builder->CreateCall(searchFunc, {array, value}));
+        return;
+    } else if (node->name == "map") {
+        if (!node->arguments.empty()) {
+            throw std::runtime_error("map() takes no arguments");
+        }
         
-        llvm::BasicBlock* loopCondBlock = llvm::BasicBlock::Create(*context, "loop_cond", currentFunction);
-        llvm::BasicBlock* loopBodyBlock = llvm::BasicBlock::Create(*context, "loop_body", currentFunction);
-        llvm::BasicBlock* loopEndBlock = llvm::BasicBlock::Create(*context, "loop_end", currentFunction);
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Function* newFunc = declareRuntimeFunction("twine_map_new", ptrType, {});
+        valueStack.push(builder->CreateCall(newFunc, {}));
+        return;
+    } else if (node->name == "get" || node->name == "set" || node->name == "has" || node->name == "delete") {
+        size_t minArgs = node->name == "set" ? 3 : 2;
+        size_t maxArgs = node->name == "has" || node->name == "delete" ? 2 : 3;
+        if (node->arguments.size() < minArgs || node->arguments.size() > maxArgs) {
+            throw std::runtime_error(node->name + "() expects " + std::to_string(minArgs) +
+                (minArgs == maxArgs ? "" : " or " + std::to_string(maxArgs)) + " arguments");
+        }
         
-        llvm::AllocaInst* indexVar = builder->CreateAlloca(llvm::Type::getInt64Ty(*context), nullptr, "index");
-        builder->CreateStore(llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 0), indexVar);
+        node->arguments[0]->accept(this);
+        llvm::Value* mapPtr = valueStack.top();
+        valueStack.pop();
         
-        builder->CreateBr(loopCondBlock);
+        node->arguments[1]->accept(this);
+        llvm::Value* key = valueStack.top();
+        valueStack.pop();
         
-        // index < length
-        builder->SetInsertPoint(loopCondBlock);
-        llvm::Value* currentIndex = builder->CreateLoad(llvm::Type::getInt64Ty(*context), indexVar, "current_index");
-        llvm::Value* condition = builder->CreateICmpULT(currentIndex, length, "loop_condition");
-        builder->CreateCondBr(condition, loopBodyBlock, loopEndBlock);
+        if (!mapPtr->getType()->isPointerTy()) {
+            throw std::runtime_error(node->name + "() expects a map as first argument");
+        }
         
-        builder->SetInsertPoint(loopBodyBlock);
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
         
-        llvm::Value* srcPtr = builder->CreateInBoundsGEP(llvm::Type::getInt8Ty(*context), value, currentIndex);
-        llvm::Value* srcChar = builder->CreateLoad(llvm::Type::getInt8Ty(*context), srcPtr, "src_char");
+        // Pointer keys are strings, unless their kind is unknown: then they
+        // may be boxed numbers, which the _any entry points unbox
+        bool pointerKey = key->getType()->isPointerTy();
+        llvm::Type* keyType = pointerKey ? ptrType : doubleType;
+        const char* keySuffix = "_num";
+        if (!pointerKey) {
+            key = convertToDouble(key);
+        } else {
+            keySuffix = expressionKind(node->arguments[1].get()) == ValueKind::String ? "_str" : "_any";
+        }
+        std::string runtimeName = "twine_map_" + node->name + keySuffix;
         
-        // Check if character is uppercase (between 'A' and 'Z')
-        llvm::Value* charA = llvm::ConstantInt::get(llvm::Type::getInt8Ty(*context), 65); // 'A'
-        llvm::Value* charZ = llvm::ConstantInt::get(llvm::Type::getInt8Ty(*context), 90); // 'Z'
-        llvm::Value* isUppercase = builder->CreateAnd(
-            builder->CreateICmpUGE(srcChar, charA),
-            builder->CreateICmpULE(srcChar, charZ)
-        );
+        if (node->name == "has" || node->name == "delete") {
+            llvm::Function* func = declareRuntimeFunction(runtimeName, doubleType, {ptrType, keyType});
+            valueStack.push(builder->CreateCall(func, {mapPtr, key}));
+            return;
+        }
         
-        // Convert to lowercase by adding 32 if it's uppercase
-        llvm::Value* lowerOffset = llvm::ConstantInt::get(llvm::Type::getInt8Ty(*context), 32);
-        llvm::Value* lowerChar = builder->CreateAdd(srcChar, lowerOffset);
-        llvm::Value* resultChar = builder->CreateSelect(isUppercase, lowerChar, srcChar);
+        // set's value and get's default are stored boxed
+        llvm::Value* extra = llvm::ConstantPointerNull::get(llvm::PointerType::getUnqual(*context));
+        if (node->arguments.size() == 3) {
+            node->arguments[2]->accept(this);
+            extra = boxValue(valueStack.top());
+            valueStack.pop();
+        }
         
-        // Store character in result buffer
-        llvm::Value* dstPtr = builder->CreateInBoundsGEP(llvm::Type::getInt8Ty(*context), resultBuffer, currentIndex);
-        builder->CreateStore(resultChar, dstPtr);
+        llvm::Function* func = declareRuntimeFunction(runtimeName, ptrType, {ptrType, keyType, ptrType});
+        valueStack.push(builder->CreateCall(func, {mapPtr, key, extra}));
+        return;
+    } else if (node->name == "keys" || node->name == "mapSize") {
+        if (node->arguments.size() != 1) {
+            throw std::runtime_error(node->name + "() expects exactly 1 argument");
+        }
         
-        llvm::Value* nextIndex = builder->CreateAdd(currentIndex, 
-            llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1));
-        builder->CreateStore(nextIndex, indexVar);
-        builder->CreateBr(loopCondBlock);
+        node->arguments[0]->accept(this);
+        llvm::Value* mapPtr = valueStack.top();
+        valueStack.pop();
         
-        builder->SetInsertPoint(loopEndBlock);
-        llvm::Value* nullTermPtr = builder->CreateInBoundsGEP(llvm::Type::getInt8Ty(*context), resultBuffer, length);
-        builder->CreateStore(llvm::ConstantInt::get(llvm::Type::getInt8Ty(*context), 0), nullTermPtr);
+        if (!mapPtr->getType()->isPointerTy()) {
+            throw std::runtime_error(node->name + "() expects a map argument");
+        }
         
-        valueStack.push(resultBuffer);
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+        if (node->name == "keys") {
+            llvm::Function* keysFunc = declareRuntimeFunction("twine_map_keys", ptrType, {ptrType});
+            valueStack.push(markArrayResult(builder->CreateCall(keysFunc, {mapPtr})));
+        } else {
+            llvm::Function* sizeFunc = declareRuntimeFunction("twine_map_size", doubleType, {ptrType});
+            valueStack.push(builder->CreateCall(sizeFunc, {mapPtr}));
+        }
         return;
-    } else if (node->name == "includes") {
+    } else if (node->name == "keyAt") {
         if (node->arguments.size() != 2) {
-            throw std::runtime_error("includes() expects exactly 2 arguments");
+            throw std::runtime_error("keyAt() expects exactly 2 arguments");
         }
         
         node->arguments[0]->accept(this);
-        llvm::Value* haystack = valueStack.top();
+        llvm::Value* mapPtr = valueStack.top();
         valueStack.pop();
-
+        
         node->arguments[1]->accept(this);
-        llvm::Value* needle = valueStack.top();
+        llvm::Value* index = convertToDouble(valueStack.top());
         valueStack.pop();
         
-        if (!haystack->getType()->isPointerTy()) {
-            throw std::runtime_error("includes() expects first argument to be a string or array");
-        }
-
-        if (needle->getType()->isPointerTy()) {
-            llvm::Function* strstrFunc = module->getFunction("strstr");
-            if (!strstrFunc) {
-                declareStrstr();
-                strstrFunc = module->getFunction("strstr");
-            }
-            
-            llvm::Value* result = builder->CreateCall(strstrFunc, {haystack, needle});
-            llvm::Value* nullPtr = llvm::ConstantPointerNull::get(llvm::PointerType::getUnqual(*context));
-            llvm::Value* found = builder->CreateICmpNE(result, nullPtr);
-            llvm::Value* doubleResult = builder->CreateUIToFP(found, llvm::Type::getDoubleTy(*context));
-            valueStack.push(doubleResult);
-        } else {
-            llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
-            llvm::Type* int64Type = llvm::Type::getInt64Ty(*context);
-            needle = convertToDouble(needle);
-            
-            llvm::Value* sizePtr = builder->CreateInBoundsGEP(doubleType, haystack, getInt64(-1));
-            llvm::Value* arraySize = builder->CreateLoad(doubleType, sizePtr);
-            llvm::Value* sizeInt = builder->CreateFPToUI(arraySize, int64Type);
-            
-            llvm::BasicBlock* loopBlock = llvm::BasicBlock::Create(*context, "loop", currentFunction);
-            llvm::BasicBlock* exitBlock = llvm::BasicBlock::Create(*context, "exit", currentFunction);
-            
-            llvm::AllocaInst* indexVar = createEntryBlockAlloca(currentFunction, "index", int64Type);
-            llvm::Value* zero = llvm::ConstantInt::get(int64Type, 0);
-            llvm::Value* one = llvm::ConstantInt::get(int64Type, 1);
-            builder->CreateStore(zero, indexVar);
-            builder->CreateBr(loopBlock);
-            
-            builder->SetInsertPoint(loopBlock);
-            llvm::Value* index = builder->CreateLoad(int64Type, indexVar);
-            llvm::Value* inBounds = builder->CreateICmpULT(index, sizeInt);
-            
-            llvm::BasicBlock* bodyBlock = llvm::BasicBlock::Create(*context, "body", currentFunction);
-            builder->CreateCondBr(inBounds, bodyBlock, exitBlock);
-            
-            builder->SetInsertPoint(bodyBlock);
-            llvm::Value* elementPtr = builder->CreateInBoundsGEP(doubleType, haystack, index);
-            llvm::Value* element = builder->CreateLoad(doubleType, elementPtr);
-            llvm::Value* isEqual = builder->CreateFCmpOEQ(element, needle);
-            
-            llvm::Value* nextIndex = builder->CreateAdd(index, one);
-            builder->CreateStore(nextIndex, indexVar);
-            builder->CreateCondBr(isEqual, exitBlock, loopBlock);
-            
-            builder->SetInsertPoint(exitBlock);
-            llvm::PHINode* result = builder->CreatePHI(doubleType, 2, "result");
-            result->addIncoming(llvm::ConstantFP::get(doubleType, 0.0), loopBlock);
-            result->addIncoming(llvm::ConstantFP::get(doubleType, 1.0), bodyBlock);
-            
-            valueStack.push(result);
+        if (!mapPtr->getType()->isPointerTy()) {
+            throw std::runtime_error("keyAt() expects a map as first argument");
         }
+        
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+        llvm::Function* keyAtFunc = declareRuntimeFunction("twine_map_key_at", ptrType, {ptrType, doubleType});
+        valueStack.push(builder->CreateCall(keyAtFunc, {mapPtr, index}));
         return;
-    } else if (node->name == "replace") {
-        if (node->arguments.size() != 3) {
-            throw std::runtime_error("replace() expects exactly 3 arguments");
+    } else if (node->name == "slice" || node->name == "substr") {
+        if (node->arguments.size() != 2 && node->arguments.size() != 3) {
+            throw std::runtime_error(node->name + "() expects 2 or 3 arguments");
         }
         
         node->arguments[0]->accept(this);
-        llvm::Value* haystack = valueStack.top();
+        llvm::Value* source = valueStack.top();
         valueStack.pop();
         
-        node->arguments[1]->accept(this);
-        llvm::Value* oldStr = valueStack.top();
-        valueStack.pop();
+        if (!source->getType()->isPointerTy()) {
+            throw std::runtime_error(node->name + "() expects a string or array as first argument");
+        }
         
-        node->arguments[2]->accept(this);
-        llvm::Value* newStr = valueStack.top();
+        node->arguments[1]->accept(this);
+        llvm::Value* start = convertToDouble(valueStack.top());
         valueStack.pop();
         
-        if (!haystack->getType()->isPointerTy() || !oldStr->getType()->isPointerTy() || !newStr->getType()->isPointerTy()) {
-            throw std::runtime_error("replace() expects three string arguments");
+        // A missing end means "to the end"; the runtime clamps it
+        llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+        llvm::Value* end = llvm::ConstantFP::getInfinity(doubleType);
+        if (node->arguments.size() == 3) {
+            node->arguments[2]->accept(this);
+            end = convertToDouble(valueStack.top());
+            valueStack.pop();
         }
         
-        llvm::Function* strstrFunc = module->getFunction("strstr");
-        if (!strstrFunc) {
-            declareStrstr();
-            strstrFunc = module->getFunction("strstr");
+        bool isString = node->name == "substr" || expressionKind(node->arguments[0].get()) == ValueKind::String;
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Function* sliceFunc = declareRuntimeFunction(isString ? "twine_substr" : "twine_slice",
+                                                           ptrType, {ptrType, doubleType, doubleType});
+        llvm::CallInst* slice = builder->CreateCall(sliceFunc, {source, start, end});
+        valueStack.push(isString ? slice : markArrayResult(slice));
+        return;
+    } else if (node->name == "array") {
+        if (node->arguments.size() != 1 && node->arguments.size() != 2) {
+            throw std::runtime_error("array() expects 1 or 2 arguments");
         }
         
-        llvm::Function* strlenFunc = module->getFunction("strlen");
-        if (!strlenFunc) {
-            declareStrlen();
-            strlenFunc = module->getFunction("strlen");
-        }
+        node->arguments[0]->accept(this);
+        llvm::Value* count = convertToDouble(valueStack.top());
+        valueStack.pop();
+        count = toCount(count);
         
-        llvm::Function* mallocFunc = module->getFunction("malloc");
-        if (!mallocFunc) {
-            declareMalloc();
-            mallocFunc = module->getFunction("malloc");
+        llvm::Value* fillValue = llvm::ConstantFP::get(llvm::Type::getDoubleTy(*context), 0.0);
+        if (node->arguments.size() == 2) {
+            node->arguments[1]->accept(this);
+            fillValue = convertToDouble(valueStack.top());
+            valueStack.pop();
         }
         
-        llvm::Value* foundPtr = builder->CreateCall(strstrFunc, {haystack, oldStr});
-        llvm::Value* nullPtr = llvm::ConstantPointerNull::get(llvm::PointerType::getUnqual(*context));
-        llvm::Value* found = builder->CreateICmpNE(foundPtr, nullPtr);
+        llvm::Value* arrayPtr = createArrayAlloc(count);
+        createArrayFill(arrayPtr, count, fillValue);
+        valueStack.push(arrayPtr);
+        return;
+    } else if (node->name == "range") {
+        // Only reached when the range is stored or passed on; for-in loops
+        // and reductions never build the array
+        llvm::Value* start = nullptr;
+        llvm::Value* step = nullptr;
+        llvm::Value* count = nullptr;
+        createRangeBounds(node, start, step, count);
+        
+        llvm::Value* arrayPtr = createArrayAlloc(count);
+        llvm::BasicBlock* preheader = builder->GetInsertBlock();
+        llvm::BasicBlock* loopBlock = llvm::BasicBlock::Create(*context, "range_loop", currentFunction);
+        llvm::BasicBlock* doneBlock = llvm::BasicBlock::Create(*context, "range_done", currentFunction);
+        builder->CreateCondBr(builder->CreateICmpEQ(count, getInt64(0)), doneBlock, loopBlock);
         
-        llvm::BasicBlock* replaceBlock = llvm::BasicBlock::Create(*context, "do_replace", currentFunction);
-        llvm::BasicBlock* noReplaceBlock = llvm::BasicBlock::Create(*context, "no_replace", currentFunction);
-        llvm::BasicBlock* mergeBlock = llvm::BasicBlock::Create(*context, "merge", currentFunction);
+        builder->SetInsertPoint(loopBlock);
+        llvm::PHINode* index = builder->CreatePHI(llvm::Type::getInt64Ty(*context), 2, "i");
+        index->addIncoming(getInt64(0), preheader);
+        llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+        llvm::Value* value = builder->CreateFAdd(start, builder->CreateFMul(builder->CreateUIToFP(index, doubleType), step));
+        tagAccess(builder->CreateStore(value, builder->CreateInBoundsGEP(doubleType, arrayPtr, index)), "array f64");
+        llvm::Value* next = builder->CreateNUWAdd(index, getInt64(1));
+        index->addIncoming(next, loopBlock);
+        builder->CreateCondBr(builder->CreateICmpULT(next, count), loopBlock, doneBlock);
+        
+        builder->SetInsertPoint(doneBlock);
+        valueStack.push(arrayPtr);
+        return;
+    } else if (node->name == "intArray" || node->name == "int64Array" ||
+               node->name == "floatArray" || node->name == "bitArray") {
+        if (node->arguments.size() != 1 && node->arguments.size() != 2) {
+            throw std::runtime_error(node->name + "() expects 1 or 2 arguments");
+        }
         
-        builder->CreateCondBr(found, replaceBlock, noReplaceBlock);
+        // TwineElementType tags from runtime/twinert.h
+        static const std::map<std::string, uint32_t> elementTypes = {
+            {"floatArray", 1}, {"intArray", 2}, {"int64Array", 3}, {"bitArray", 4}
+        };
         
-        builder->SetInsertPoint(noReplaceBlock);
-        llvm::Value* haystackLen = builder->CreateCall(strlenFunc, {haystack});
-        llvm::Value* haystackLenPlus1 = builder->CreateAdd(haystackLen, 
-            llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1));
-        llvm::Value* originalCopy = builder->CreateCall(mallocFunc, {haystackLenPlus1});
+        node->arguments[0]->accept(this);
+        llvm::Value* count = convertToDouble(valueStack.top());
+        valueStack.pop();
+        count = toCount(count);
         
-        llvm::Function* strcpyFunc = module->getFunction("strcpy");
-        if (!strcpyFunc) {
-            declareStrcpy();
-            strcpyFunc = module->getFunction("strcpy");
-        }
-        builder->CreateCall(strcpyFunc, {originalCopy, haystack});
-        builder->CreateBr(mergeBlock);
+        // The runtime zero-fills typed arrays
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+        llvm::Function* allocFunc = declareRuntimeFunction("twine_typed_array_alloc", ptrType,
+            {llvm::Type::getInt64Ty(*context), llvm::Type::getInt32Ty(*context)});
+        llvm::Value* arrayPtr = markArrayResult(
+            builder->CreateCall(allocFunc, {count, getInt32(elementTypes.at(node->name))}, "array"));
         
-        builder->SetInsertPoint(replaceBlock);
-        
-        llvm::Value* oldLen = builder->CreateCall(strlenFunc, {oldStr});
-        llvm::Value* newLen = builder->CreateCall(strlenFunc, {newStr});
-        llvm::Value* prefixLen = builder->CreatePtrToInt(foundPtr, llvm::Type::getInt64Ty(*context));
-        llvm::Value* haystackInt = builder->CreatePtrToInt(haystack, llvm::Type::getInt64Ty(*context));
-        prefixLen = builder->CreateSub(prefixLen, haystackInt);
-        llvm::Value* suffixStart = builder->CreateInBoundsGEP(llvm::Type::getInt8Ty(*context), foundPtr, oldLen);
-        llvm::Value* suffixLen = builder->CreateCall(strlenFunc, {suffixStart});
-        llvm::Value* resultLen = builder->CreateAdd(prefixLen, newLen);
-        resultLen = builder->CreateAdd(resultLen, suffixLen);
-        resultLen = builder->CreateAdd(resultLen, llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1));
-        
-        llvm::Value* resultBuffer = builder->CreateCall(mallocFunc, {resultLen});
-        
-        if (!module->getFunction("strncpy")) {
-            std::vector<llvm::Type*> params = {
-                llvm::PointerType::getUnqual(*context), // char* dest
-                llvm::PointerType::getUnqual(*context), // const char* src
-                llvm::Type::getInt64Ty(*context) // size_t n
-            };
-            llvm::FunctionType* funcType = llvm::FunctionType::get(
-                llvm::PointerType::getUnqual(*context),
-                params,
-                false
-            );
-            llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, "strncpy", *module);
+        if (node->arguments.size() == 2) {
+            node->arguments[1]->accept(this);
+            llvm::Value* fillValue = convertToDouble(valueStack.top());
+            valueStack.pop();
+            llvm::Function* fillFunc = declareRuntimeFunction("twine_array_fill", ptrType, {ptrType, doubleType});
+            builder->CreateCall(fillFunc, {arrayPtr, fillValue});
         }
         
-        llvm::Function* strncpyFunc = module->getFunction("strncpy");
-        builder->CreateCall(strncpyFunc, {resultBuffer, haystack, prefixLen});
-        llvm::Value* afterPrefix = builder->CreateInBoundsGEP(llvm::Type::getInt8Ty(*context), resultBuffer, prefixLen);
-        builder->CreateStore(llvm::ConstantInt::get(llvm::Type::getInt8Ty(*context), 0), afterPrefix);
-        llvm::Function* strcatFunc = module->getFunction("strcat");
-        if (!strcatFunc) {
-            declareStrcat();
-            strcatFunc = module->getFunction("strcat");
+        valueStack.push(arrayPtr);
+        return;
+    } else if (node->name == "fill") {
+        if (node->arguments.size() != 2) {
+            throw std::runtime_error("fill() expects exactly 2 arguments");
         }
-        builder->CreateCall(strcatFunc, {resultBuffer, newStr});
-        builder->CreateCall(strcatFunc, {resultBuffer, suffixStart});
         
-        builder->CreateBr(mergeBlock);
+        node->arguments[0]->accept(this);
+        llvm::Value* arrayPtr = valueStack.top();
+        valueStack.pop();
+        
+        node->arguments[1]->accept(this);
+        llvm::Value* fillValue = convertToDouble(valueStack.top());
+        valueStack.pop();
         
-        builder->SetInsertPoint(mergeBlock);
-        llvm::PHINode* resultPhi = builder->CreatePHI(llvm::PointerType::getUnqual(*context), 2, "replace_result");
-        resultPhi->addIncoming(originalCopy, noReplaceBlock);
-        resultPhi->addIncoming(resultBuffer, replaceBlock);
+        if (!arrayPtr->getType()->isPointerTy()) {
+            throw std::runtime_error("fill() expects an array as first argument");
+        }
         
-        valueStack.push(resultPhi);
+        if (expressionKind(node->arguments[0].get()) == ValueKind::Array) {
+            createArrayFill(arrayPtr, loadArrayCount(arrayPtr), fillValue);
+        } else {
+            // Typed or unknown element type: the runtime reads the tag
+            llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+            llvm::Function* fillFunc = declareRuntimeFunction("twine_array_fill", ptrType,
+                {ptrType, llvm::Type::getDoubleTy(*context)});
+            builder->CreateCall(fillFunc, {arrayPtr, fillValue});
+        }
+        valueStack.push(arrayPtr);
         return;
-    } else if (node->name == "append") {
+    } else if (node->name == "copy") {
         if (node->arguments.size() != 2) {
-            throw std::runtime_error("append() expects exactly 2 arguments");
+            throw std::runtime_error("copy() expects exactly 2 arguments");
         }
         
         node->arguments[0]->accept(this);
-        llvm::Value* arrayPtr = valueStack.top();
+        llvm::Value* dst = valueStack.top();
         valueStack.pop();
         
         node->arguments[1]->accept(this);
-        llvm::Value* newValue = valueStack.top();
+        llvm::Value* src = valueStack.top();
         valueStack.pop();
         
-        if (!arrayPtr->getType()->isPointerTy()) {
-            throw std::runtime_error("append() expects an array as first argument");
+        if (!dst->getType()->isPointerTy() || !src->getType()->isPointerTy()) {
+            throw std::runtime_error("copy() expects two array arguments");
         }
         
-        llvm::Type* elementType = llvm::Type::getDoubleTy(*context);
-        newValue = convertToDouble(newValue);
+        // Only number arrays known statically are copied inline; otherwise
+        // the runtime reads the element types from the tags
+        if (expressionKind(node->arguments[0].get()) != ValueKind::Array ||
+            expressionKind(node->arguments[1].get()) != ValueKind::Array) {
+            llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+            llvm::Function* copyFunc = declareRuntimeFunction("twine_array_copy", ptrType, {ptrType, ptrType});
+            valueStack.push(builder->CreateCall(copyFunc, {dst, src}));
+            return;
+        }
         
-        llvm::Value* sizePtr = builder->CreateInBoundsGEP(elementType, arrayPtr, getInt64(-1));
-        llvm::Value* currentSize = builder->CreateLoad(elementType, sizePtr);
-        llvm::Value* currentSizeInt = builder->CreateFPToUI(currentSize, llvm::Type::getInt64Ty(*context));
+        // Copies as many elements as fit; memmove because dst may be src
+        llvm::Value* dstCount = loadArrayCount(dst);
+        llvm::Value* srcCount = loadArrayCount(src);
+        llvm::Value* count = builder->CreateSelect(builder->CreateICmpULT(srcCount, dstCount), srcCount, dstCount);
+        builder->CreateMemMove(dst, llvm::MaybeAlign(8), src, llvm::MaybeAlign(8), builder->CreateMul(count, getInt64(8)));
+        valueStack.push(dst);
+        return;
+    } else if (node->name == "concat") {
+        if (node->arguments.size() != 2) {
+            throw std::runtime_error("concat() expects exactly 2 arguments");
+        }
         
-        llvm::Value* newSize = builder->CreateAdd(currentSizeInt, 
-            llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1));
-        llvm::Value* elementSize = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 8);
-        llvm::Value* totalElements = builder->CreateAdd(newSize, 
-            llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1));
-        llvm::Value* totalSize = builder->CreateMul(totalElements, elementSize);
+        node->arguments[0]->accept(this);
+        llvm::Value* left = valueStack.top();
+        valueStack.pop();
         
-        llvm::Function* mallocFunc = module->getFunction("malloc");
-        if (!mallocFunc) {
-            declareMalloc();
-            mallocFunc = module->getFunction("malloc");
+        node->arguments[1]->accept(this);
+        llvm::Value* right = valueStack.top();
+        valueStack.pop();
+        
+        if (expressionKind(node->arguments[0].get()) == ValueKind::String ||
+            expressionKind(node->arguments[1].get()) == ValueKind::String) {
+            valueStack.push(createStringConcatenation(left, right));
+            return;
         }
         
-        llvm::Value* newArrayPtr = builder->CreateCall(mallocFunc, {totalSize});
-        llvm::Value* typedNewArrayPtr = builder->CreateBitCast(newArrayPtr, llvm::PointerType::getUnqual(elementType));
+        if (!left->getType()->isPointerTy() || !right->getType()->isPointerTy()) {
+            throw std::runtime_error("concat() expects two arrays or strings");
+        }
         
-        llvm::Value* newSizeDouble = builder->CreateUIToFP(newSize, elementType);
-        builder->CreateStore(newSizeDouble, typedNewArrayPtr);
+        if (expressionKind(node->arguments[0].get()) != ValueKind::Array ||
+            expressionKind(node->arguments[1].get()) != ValueKind::Array) {
+            llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+            llvm::Function* concatFunc = declareRuntimeFunction("twine_array_concat", ptrType, {ptrType, ptrType});
+            valueStack.push(markArrayResult(builder->CreateCall(concatFunc, {left, right})));
+            return;
+        }
         
-        llvm::Value* newDataPtr = builder->CreateInBoundsGEP(elementType, typedNewArrayPtr,
-            llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1));
+        llvm::Value* leftCount = loadArrayCount(left);
+        llvm::Value* rightCount = loadArrayCount(right);
+        llvm::Value* result = createArrayAlloc(builder->CreateAdd(leftCount, rightCount));
+        llvm::Value* rightStart = builder->CreateInBoundsGEP(llvm::Type::getDoubleTy(*context), result, leftCount);
+        builder->CreateMemCpy(result, llvm::MaybeAlign(8), left, llvm::MaybeAlign(8), builder->CreateMul(leftCount, getInt64(8)));
+        builder->CreateMemCpy(rightStart, llvm::MaybeAlign(8), right, llvm::MaybeAlign(8), builder->CreateMul(rightCount, getInt64(8)));
+        valueStack.push(result);
+        return;
+    } else if (node->name == "replace" || node->name == "replaceAll") {
+        if (node->arguments.size() != 3) {
+            throw std::runtime_error(node->name + "() expects exactly 3 arguments");
+        }
         
-        llvm::BasicBlock* loopBlock = llvm::BasicBlock::Create(*context, "copy_loop", currentFunction);
-        llvm::BasicBlock* loopEndBlock = llvm::BasicBlock::Create(*context, "copy_end", currentFunction);
+        node->arguments[0]->accept(this);
+        llvm::Value* haystack = valueStack.top();
+        valueStack.pop();
         
-        llvm::AllocaInst* indexVar = builder->CreateAlloca(llvm::Type::getInt64Ty(*context), nullptr, "copy_index");
-        builder->CreateStore(llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 0), indexVar);
+        node->arguments[1]->accept(this);
+        llvm::Value* oldStr = valueStack.top();
+        valueStack.pop();
         
-        builder->CreateBr(loopBlock);
+        node->arguments[2]->accept(this);
+        llvm::Value* newStr = valueStack.top();
+        valueStack.pop();
         
-        builder->SetInsertPoint(loopBlock);
-        llvm::Value* currentIndex = builder->CreateLoad(llvm::Type::getInt64Ty(*context), indexVar);
-        llvm::Value* condition = builder->CreateICmpULT(currentIndex, currentSizeInt);
+        if (!haystack->getType()->isPointerTy() || !oldStr->getType()->isPointerTy() || !newStr->getType()->isPointerTy()) {
+            throw std::runtime_error(node->name + "() expects three string arguments");
+        }
         
-        llvm::BasicBlock* loopBodyBlock = llvm::BasicBlock::Create(*context, "copy_body", currentFunction);
-        builder->CreateCondBr(condition, loopBodyBlock, loopEndBlock);
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        const char* runtimeName = node->name == "replace" ? "twine_replace" : "twine_replace_all";
+        llvm::Function* replaceFunc = declareRuntimeFunction(runtimeName, ptrType, {ptrType, ptrType, ptrType});
+        valueStack.push(builder->CreateCall(replaceFunc, {haystack, oldStr, newStr}));
+        return;
+    } else if (node->name == "append") {
+        if (node->arguments.size() != 2) {
+            throw std::runtime_error("append() expects exactly 2 arguments");
+        }
         
-        builder->SetInsertPoint(loopBodyBlock);
-        llvm::Value* srcPtr = builder->CreateInBoundsGEP(elementType, arrayPtr, currentIndex);
-        llvm::Value* dstPtr = builder->CreateInBoundsGEP(elementType, newDataPtr, currentIndex);
-        llvm::Value* element = builder->CreateLoad(elementType, srcPtr);
-        builder->CreateStore(element, dstPtr);
+        node->arguments[0]->accept(this);
+        llvm::Value* arrayPtr = valueStack.top();
+        valueStack.pop();
         
-        llvm::Value* nextIndex = builder->CreateAdd(currentIndex,
-            llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1));
-        builder->CreateStore(nextIndex, indexVar);
-        builder->CreateBr(loopBlock);
+        node->arguments[1]->accept(this);
+        llvm::Value* newValue = valueStack.top();
+        valueStack.pop();
         
-        builder->SetInsertPoint(loopEndBlock);
-        llvm::Value* lastElementPtr = builder->CreateInBoundsGEP(elementType, newDataPtr, currentSizeInt);
-        builder->CreateStore(newValue, lastElementPtr);
+        if (!arrayPtr->getType()->isPointerTy()) {
+            throw std::runtime_error("append() expects an array as first argument");
+        }
+        
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+        newValue = convertToDouble(newValue);
         
-        valueStack.push(newDataPtr);
+        llvm::Function* appendFunc = declareRuntimeFunction("twine_append", ptrType, {ptrType, doubleType});
+        valueStack.push(markArrayResult(builder->CreateCall(appendFunc, {arrayPtr, newValue})));
+        return;
+    } else if (node->name == "saveArray") {
+        if (node->arguments.size() != 2) {
+            throw std::runtime_error("saveArray() expects exactly 2 arguments");
+        }
+
+        node->arguments[0]->accept(this);
+        llvm::Value* path = valueStack.top();
+        valueStack.pop();
+
+        node->arguments[1]->accept(this);
+        llvm::Value* arrayPtr = valueStack.top();
+        valueStack.pop();
+
+        if (!path->getType()->isPointerTy() || !arrayPtr->getType()->isPointerTy()) {
+            throw std::runtime_error("saveArray() expects a path and an array");
+        }
+
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Function* saveFunc = declareRuntimeFunction("twine_save_array", llvm::Type::getDoubleTy(*context), {ptrType, ptrType});
+        valueStack.push(builder->CreateCall(saveFunc, {path, arrayPtr}));
+        return;
+    } else if (node->name == "loadArray") {
+        if (node->arguments.size() != 1) {
+            throw std::runtime_error("loadArray() expects exactly 1 argument");
+        }
+
+        node->arguments[0]->accept(this);
+        llvm::Value* path = valueStack.top();
+        valueStack.pop();
+
+        if (!path->getType()->isPointerTy()) {
+            throw std::runtime_error("loadArray() expects a path string");
+        }
+
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Function* loadFunc = declareRuntimeFunction("twine_load_array", ptrType, {ptrType});
+        valueStack.push(markArrayResult(builder->CreateCall(loadFunc, {path})));
         return;
     } else if (node->name == "print") {
         if (node->arguments.empty()) {
@@ -2251,23 +3005,9 @@ void CodeGenerator::visit(ExpressionStatement* node) {
 void CodeGenerator::visit(ArrayLiteral* node) {
     llvm::Type* elementType = llvm::Type::getDoubleTy(*context);
     
-    llvm::Function* mallocFunc = module->getFunction("malloc");
-    if (!mallocFunc) {
-        declareMalloc();
-        mallocFunc = module->getFunction("malloc");
-    }
-    
-    // Calculate memory size: (elements + 1 for size metadata) * sizeof(double)
+    // The runtime allocator writes the header (element type and count)
     size_t elementCount = node->elements.size();
-    llvm::Value* totalSize = getInt64((elementCount + 1) * 8);
-    
-    llvm::Value* arrayPtr = builder->CreateCall(mallocFunc, {totalSize});
-    llvm::Value* typedArrayPtr = builder->CreateBitCast(arrayPtr, llvm::PointerType::getUnqual(elementType));
-    
-    llvm::Value* arraySizeDouble = llvm::ConstantFP::get(elementType, static_cast<double>(elementCount));
-    builder->CreateStore(arraySizeDouble, typedArrayPtr);
-    
-    llvm::Value* dataPtr = builder->CreateInBoundsGEP(elementType, typedArrayPtr, getInt64(1));
+    llvm::Value* dataPtr = createArrayAlloc(getInt64(elementCount));
     
     for (size_t i = 0; i < node->elements.size(); ++i) {
         node->elements[i]->accept(this);
@@ -2277,7 +3017,7 @@ void CodeGenerator::visit(ArrayLiteral* node) {
         value = convertToDouble(value);
         
         llvm::Value* elementPtr = builder->CreateInBoundsGEP(elementType, dataPtr, getInt64(i));
-        builder->CreateStore(value, elementPtr);
+        tagAccess(builder->CreateStore(value, elementPtr), "array f64");
     }
     
     valueStack.push(dataPtr);
@@ -2292,15 +3032,40 @@ void CodeGenerator::visit(IndexExpression* node) {
     llvm::Value* index = valueStack.top();
     valueStack.pop();
     
+    ValueKind kind = expressionKind(node->array.get());
+    llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+    
+    if (kind == ValueKind::String) {
+        // s[i] is the one-character string at byte i
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Function* charAtFunc = declareRuntimeFunction("twine_char_at", ptrType, {ptrType, doubleType});
+        valueStack.push(builder->CreateCall(charAtFunc, {arrayPtr, convertToDouble(index)}));
+        return;
+    }
+    
+    if (kind == ValueKind::AnyArray) {
+        // Element type unknown at compile time: the runtime reads the tag
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Function* getFunc = declareRuntimeFunction("twine_array_get", doubleType, {ptrType, doubleType});
+        valueStack.push(builder->CreateCall(getFunc, {arrayPtr, convertToDouble(index)}));
+        return;
+    }
+    
+    if (kind != ValueKind::Array && !isTypedArrayKind(kind)) {
+        // Could be a string or any array; the result is boxed like a
+        // function's
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Function* elementFunc = declareRuntimeFunction("twine_element_at", ptrType, {ptrType, doubleType});
+        valueStack.push(builder->CreateCall(elementFunc, {arrayPtr, convertToDouble(index)}));
+        return;
+    }
+    
     if (!index->getType()->isIntegerTy()) {
         index = builder->CreateFPToUI(index, llvm::Type::getInt64Ty(*context));
     }
     
-    llvm::Type* elementType = llvm::Type::getDoubleTy(*context);
-    llvm::Value* elementPtr = builder->CreateInBoundsGEP(elementType, arrayPtr, index);
-    llvm::Value* value = builder->CreateLoad(elementType, elementPtr);
-    
-    valueStack.push(value);
+    llvm::Value* elementPtr = createElementAddress(kind, arrayPtr, index);
+    valueStack.push(createElementLoad(kind, elementPtr, index));
 }
 
 void CodeGenerator::visit(IndexAssignmentExpression* node) {
@@ -2316,19 +3081,82 @@ void CodeGenerator::visit(IndexAssignmentExpression* node) {
     llvm::Value* value = valueStack.top();
     valueStack.pop();
     
+    ValueKind kind = expressionKind(node->array.get());
+    llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+    value = convertToDouble(value);
+    
+    if (kind != ValueKind::Array && !isTypedArrayKind(kind)) {
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Function* setFunc = declareRuntimeFunction("twine_array_set", doubleType, {ptrType, doubleType, doubleType});
+        builder->CreateCall(setFunc, {arrayPtr, convertToDouble(index), value});
+        valueStack.push(value);
+        return;
+    }
+    
     if (!index->getType()->isIntegerTy()) {
         index = builder->CreateFPToUI(index, llvm::Type::getInt64Ty(*context));
     }
     
-    llvm::Type* elementType = llvm::Type::getDoubleTy(*context);
-    value = convertToDouble(value);
-    
-    llvm::Value* elementPtr = builder->CreateInBoundsGEP(elementType, arrayPtr, index);
-    builder->CreateStore(value, elementPtr);
-
+    createElementStore(kind, createElementAddress(kind, arrayPtr, index), index, value);
     valueStack.push(value);
 }
 
+void CodeGenerator::visit(CompoundAssignmentExpression* node) {
+    llvm::Value* oldValue = nullptr;
+    llvm::Value* newValue = nullptr;
+    
+    if (auto* variable = dynamic_cast<Identifier*>(node->target.get())) {
+        oldValue = getVariable(variable->name);
+        if (!oldValue) {
+            throw std::runtime_error("Undefined variable: " + variable->name);
+        }
+        node->value->accept(this);
+        llvm::Value* value = valueStack.top();
+        valueStack.pop();
+        
+        newValue = createArithmetic(node->op, oldValue, value);
+        setVariable(variable->name, newValue);
+        recordVariableKind(variable->name, expressionKind(node));
+    } else {
+        // a[i] op= x: the array and index are evaluated once, and the read
+        // and the write share one element address
+        auto* target = static_cast<IndexExpression*>(node->target.get());
+        target->array->accept(this);
+        llvm::Value* arrayPtr = valueStack.top();
+        valueStack.pop();
+        target->index->accept(this);
+        llvm::Value* index = convertToDouble(valueStack.top());
+        valueStack.pop();
+        
+        ValueKind kind = expressionKind(target->array.get());
+        llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+        llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+        llvm::Value* elementPtr = nullptr;
+        if (kind == ValueKind::Array || isTypedArrayKind(kind)) {
+            index = builder->CreateFPToUI(index, llvm::Type::getInt64Ty(*context));
+            elementPtr = createElementAddress(kind, arrayPtr, index);
+            oldValue = createElementLoad(kind, elementPtr, index);
+        } else {
+            llvm::Function* getFunc = declareRuntimeFunction("twine_array_get", doubleType, {ptrType, doubleType});
+            oldValue = builder->CreateCall(getFunc, {arrayPtr, index});
+        }
+        
+        node->value->accept(this);
+        llvm::Value* value = convertToDouble(valueStack.top());
+        valueStack.pop();
+        newValue = createArithmetic(node->op, oldValue, value);
+        
+        if (elementPtr) {
+            createElementStore(kind, elementPtr, index, newValue);
+        } else {
+            llvm::Function* setFunc = declareRuntimeFunction("twine_array_set", doubleType, {ptrType, doubleType, doubleType});
+            builder->CreateCall(setFunc, {arrayPtr, index, newValue});
+        }
+    }
+    
+    valueStack.push(node->postfix ? oldValue : newValue);
+}
+
 void CodeGenerator::visit(VariableDeclaration* node) {
     llvm::Value* value = nullptr;
     
@@ -2345,6 +3173,7 @@ void CodeGenerator::visit(VariableDeclaration* node) {
         llvm::AllocaInst* alloca = createEntryBlockAlloca(currentFunction, node->name, value->getType());
         builder->CreateStore(value, alloca);
         symbolTables.back()[node->name] = alloca;
+        variableKinds[alloca] = node->initializer ? expressionKind(node->initializer.get()) : ValueKind::Number;
     }
 }
 
@@ -2396,8 +3225,65 @@ void CodeGenerator::visit(IfStatement* node) {
     builder->SetInsertPoint(mergeBlock);
 }
 
+// What --fast-math and @fastmath allow: reassociation (which lets the
+// vectorizer reorder reductions), contraction into FMA, and ignoring the
+// sign of zero. Not nnan/ninf, which would fold away the compiler's own
+// NaN checks, such as the counted-loop bound and switch label guards.
+static llvm::FastMathFlags relaxedMathFlags() {
+    llvm::FastMathFlags flags;
+    flags.setAllowReassoc();
+    flags.setAllowContract();
+    flags.setNoSignedZeros();
+    return flags;
+}
+
+void CodeGenerator::setFastMath(bool enabled) {
+    // The builder stamps these flags on every floating-point instruction
+    builder->setFastMathFlags(enabled ? relaxedMathFlags() : llvm::FastMathFlags());
+}
+
+void CodeGenerator::attachLoopHints(llvm::Instruction* backEdge, const LoopHints& hints) {
+    std::vector<llvm::Metadata*> operands = {nullptr};  // self reference, filled in below
+    auto addProperty = [&](const char* name, llvm::Metadata* value) {
+        std::vector<llvm::Metadata*> property = {llvm::MDString::get(*context, name)};
+        if (value) property.push_back(value);
+        operands.push_back(llvm::MDNode::get(*context, property));
+    };
+    auto count = [&](int value) {
+        return llvm::ConstantAsMetadata::get(builder->getInt32(value));
+    };
+    
+    if (hints.vectorizeWidth == 1) {
+        addProperty("llvm.loop.vectorize.width", count(1));
+    } else if (hints.vectorizeWidth > 1) {
+        // An explicit width also lets the vectorizer reorder FP reductions
+        addProperty("llvm.loop.vectorize.enable", llvm::ConstantAsMetadata::get(builder->getTrue()));
+        addProperty("llvm.loop.vectorize.width", count(hints.vectorizeWidth));
+    }
+    if (hints.unrollCount == 1) {
+        addProperty("llvm.loop.unroll.disable", nullptr);
+    } else if (hints.unrollCount > 1) {
+        addProperty("llvm.loop.unroll.count", count(hints.unrollCount));
+    }
+    
+    if (operands.size() == 1) {
+        return;
+    }
+    llvm::MDNode* loopID = llvm::MDNode::getDistinct(*context, operands);
+    loopID->replaceOperandWith(0, loopID);
+    backEdge->setMetadata(llvm::LLVMContext::MD_loop, loopID);
+}
+
 void CodeGenerator::visit(WhileStatement* node) {
     llvm::Function* function = builder->GetInsertBlock()->getParent();
+    functionsWithLoops.insert(function);
+    
+    llvm::IRBuilderBase::FastMathFlagGuard fastMathGuard(*builder);
+    if (node->hints.fastMath) {
+        builder->setFastMathFlags(relaxedMathFlags());
+    }
+    
+    joinLoopVariableKinds({node->condition.get(), node->body.get()});
     
     llvm::BasicBlock* condBlock = llvm::BasicBlock::Create(*context, "while.cond", function);
     llvm::BasicBlock* bodyBlock = llvm::BasicBlock::Create(*context, "while.body", function);
@@ -2415,22 +3301,298 @@ void CodeGenerator::visit(WhileStatement* node) {
     
     // Body block
     builder->SetInsertPoint(bodyBlock);
+    loopTargets.push_back({endBlock, condBlock});
+    node->body->accept(this);
+    loopTargets.pop_back();
+    if (!builder->GetInsertBlock()->getTerminator()) {
+        attachLoopHints(builder->CreateBr(condBlock), node->hints);
+    }
+    
+    // End block
+    builder->SetInsertPoint(endBlock);
+}
+
+using AssignmentVisitor = std::function<void(const std::string&, Expression*)>;
+
+static void forEachAssignment(ASTNode* node, const AssignmentVisitor& visit, std::vector<std::string>& declared) {
+    auto walk = [&](ASTNode* child) { forEachAssignment(child, visit, declared); };
+    auto isDeclared = [&](const std::string& name) {
+        return std::find(declared.begin(), declared.end(), name) != declared.end();
+    };
+    if (!node) {
+        return;
+    } else if (auto* assignment = dynamic_cast<AssignmentExpression*>(node)) {
+        walk(assignment->value.get());
+        if (!isDeclared(assignment->name)) visit(assignment->name, assignment->value.get());
+    } else if (auto* declaration = dynamic_cast<VariableDeclaration*>(node)) {
+        walk(declaration->initializer.get());
+        declared.push_back(declaration->name);
+    } else if (auto* compound = dynamic_cast<CompoundAssignmentExpression*>(node)) {
+        walk(compound->target.get());
+        walk(compound->value.get());
+        auto* variable = dynamic_cast<Identifier*>(compound->target.get());
+        if (variable && !isDeclared(variable->name)) visit(variable->name, compound);
+    } else if (auto* indexAssignment = dynamic_cast<IndexAssignmentExpression*>(node)) {
+        walk(indexAssignment->array.get());
+        walk(indexAssignment->index.get());
+        walk(indexAssignment->value.get());
+    } else if (auto* binary = dynamic_cast<BinaryExpression*>(node)) {
+        walk(binary->left.get());
+        walk(binary->right.get());
+    } else if (auto* unary = dynamic_cast<UnaryExpression*>(node)) {
+        walk(unary->operand.get());
+    } else if (auto* conditional = dynamic_cast<ConditionalExpression*>(node)) {
+        walk(conditional->condition.get());
+        walk(conditional->thenValue.get());
+        walk(conditional->elseValue.get());
+    } else if (auto* index = dynamic_cast<IndexExpression*>(node)) {
+        walk(index->array.get());
+        walk(index->index.get());
+    } else if (auto* call = dynamic_cast<CallExpression*>(node)) {
+        for (auto& argument : call->arguments) walk(argument.get());
+    } else if (auto* array = dynamic_cast<ArrayLiteral*>(node)) {
+        for (auto& element : array->elements) walk(element.get());
+    } else if (auto* expression = dynamic_cast<ExpressionStatement*>(node)) {
+        walk(expression->expression.get());
+    } else if (auto* block = dynamic_cast<BlockStatement*>(node)) {
+        size_t outer = declared.size();
+        for (auto& statement : block->statements) walk(statement.get());
+        declared.resize(outer);
+    } else if (auto* ifStatement = dynamic_cast<IfStatement*>(node)) {
+        walk(ifStatement->condition.get());
+        walk(ifStatement->thenStatement.get());
+        walk(ifStatement->elseStatement.get());
+    } else if (auto* whileStatement = dynamic_cast<WhileStatement*>(node)) {
+        walk(whileStatement->condition.get());
+        walk(whileStatement->body.get());
+    } else if (auto* forStatement = dynamic_cast<ForStatement*>(node)) {
+        walk(forStatement->init.get());
+        walk(forStatement->condition.get());
+        walk(forStatement->update.get());
+        walk(forStatement->body.get());
+    } else if (auto* switchStatement = dynamic_cast<SwitchStatement*>(node)) {
+        walk(switchStatement->discriminant.get());
+        size_t outer = declared.size();
+        for (auto& switchCase : switchStatement->cases) {
+            walk(switchCase.value.get());
+            for (auto& statement : switchCase.body) walk(statement.get());
+        }
+        declared.resize(outer);
+    } else if (auto* forIn = dynamic_cast<ForInStatement*>(node)) {
+        walk(forIn->iterable.get());
+        size_t outer = declared.size();
+        declared.push_back(forIn->name);
+        walk(forIn->body.get());
+        declared.resize(outer);
+    } else if (auto* returnStatement = dynamic_cast<ReturnStatement*>(node)) {
+        walk(returnStatement->value.get());
+    }
+}
+
+// Calls visit(name, value) for every assignment in the subtree to a variable
+// declared outside it. value is the assigned expression (the whole
+// expression for compound assignments). Function bodies are skipped since
+// they can't reach the caller's locals.
+static void forEachAssignment(ASTNode* node, const AssignmentVisitor& visit) {
+    std::vector<std::string> declared;
+    forEachAssignment(node, visit, declared);
+}
+
+// Whether anything in the subtree assigns the variable
+static bool assignsVariable(ASTNode* node, const std::string& name) {
+    bool assigns = false;
+    forEachAssignment(node, [&](const std::string& assigned, Expression*) {
+        assigns = assigns || assigned == name;
+    });
+    return assigns;
+}
+
+void CodeGenerator::joinLoopVariableKinds(const std::vector<ASTNode*>& loopParts) {
+    // Kinds are recorded in source order, but a loop body runs again after
+    // its own assignments: a[i] compiled before `a = array(...)` also sees
+    // the new array. Each variable assigned in the loop gets the join of its
+    // kind and every kind assigned to it, repeated until nothing changes
+    // since one assignment's kind can depend on another's (b = a).
+    std::map<llvm::AllocaInst*, ValueKind> before;
+    do {
+        before = variableKinds;
+        for (ASTNode* part : loopParts) {
+            forEachAssignment(part, [this](const std::string& name, Expression* value) {
+                recordVariableKind(name, expressionKind(value));
+            });
+        }
+    } while (variableKinds != before);
+}
+
+// An integer literal small enough that doubles count it exactly
+static bool isExactIntegerLiteral(Expression* expr, double& value) {
+    auto* literal = dynamic_cast<NumberLiteral*>(expr);
+    if (!literal || literal->value != std::trunc(literal->value) || std::fabs(literal->value) > 9007199254740992.0) {
+        return false;
+    }
+    value = literal->value;
+    return true;
+}
+
+bool CodeGenerator::emitCountedFor(ForStatement* node) {
+    // Only `for (let i = A; i < B; i = i + C)` and its descending mirror
+    // `for (let i = A; i > B; i = i - C)`, with <= and >= too, where A and C
+    // are integer literals, B doesn't change in the body (a number variable,
+    // a literal or len(x)), and the body leaves i alone. Anything else takes
+    // the general path.
+    std::string name;
+    Expression* startExpr = nullptr;
+    if (auto* declaration = dynamic_cast<VariableDeclaration*>(node->init.get())) {
+        name = declaration->name;
+        startExpr = declaration->initializer.get();
+    } else if (auto* statement = dynamic_cast<ExpressionStatement*>(node->init.get())) {
+        if (auto* assignment = dynamic_cast<AssignmentExpression*>(statement->expression.get())) {
+            name = assignment->name;
+            startExpr = assignment->value.get();
+        }
+    }
+    double start = 0.0;
+    if (name.empty() || !isExactIntegerLiteral(startExpr, start)) {
+        return false;
+    }
+    
+    auto* condition = dynamic_cast<BinaryExpression*>(node->condition.get());
+    auto* conditionVar = condition ? dynamic_cast<Identifier*>(condition->left.get()) : nullptr;
+    if (!conditionVar || conditionVar->name != name) {
+        return false;
+    }
+    bool ascending = condition->op == "<" || condition->op == "<=";
+    bool inclusive = condition->op == "<=" || condition->op == ">=";
+    if (!ascending && condition->op != ">" && condition->op != ">=") {
+        return false;
+    }
+    
+    // The update can be i = i + C, i = C + i, i = i - C, i += C, i -= C,
+    // or i++ / i-- in either position
+    std::string stepOp;
+    Expression* stepExpr = nullptr;
+    if (auto* update = dynamic_cast<AssignmentExpression*>(node->update.get())) {
+        auto* increment = dynamic_cast<BinaryExpression*>(update->value.get());
+        auto* left = increment ? dynamic_cast<Identifier*>(increment->left.get()) : nullptr;
+        auto* right = increment ? dynamic_cast<Identifier*>(increment->right.get()) : nullptr;
+        if (update->name == name && left && left->name == name) {
+            stepOp = increment->op;
+            stepExpr = increment->right.get();
+        } else if (update->name == name && right && right->name == name && increment->op == "+") {
+            stepOp = "+";
+            stepExpr = increment->left.get();
+        }
+    } else if (auto* compound = dynamic_cast<CompoundAssignmentExpression*>(node->update.get())) {
+        auto* target = dynamic_cast<Identifier*>(compound->target.get());
+        if (target && target->name == name) {
+            stepOp = compound->op;
+            stepExpr = compound->value.get();
+        }
+    }
+    double step = 0.0;
+    if ((stepOp != "+" && stepOp != "-") || !isExactIntegerLiteral(stepExpr, step) || step <= 0.0 ||
+        (stepOp == "+") != ascending) {
+        return false;
+    }
+    
+    Expression* boundExpr = condition->right.get();
+    auto* boundVar = dynamic_cast<Identifier*>(boundExpr);
+    auto* boundCall = dynamic_cast<CallExpression*>(boundExpr);
+    if (boundCall && boundCall->name == "len" && boundCall->arguments.size() == 1) {
+        boundVar = dynamic_cast<Identifier*>(boundCall->arguments[0].get());
+        if (!boundVar) return false;
+    } else if (!boundVar && !dynamic_cast<NumberLiteral*>(boundExpr)) {
+        return false;
+    }
+    if (assignsVariable(node->body.get(), name) || (boundVar && (boundVar->name == name ||
+                                                                  assignsVariable(node->body.get(), boundVar->name)))) {
+        return false;
+    }
+    
+    llvm::AllocaInst* variable = findVariable(name);
+    if (!variable || !variable->getAllocatedType()->isDoubleTy()) {
+        return false;
+    }
+    
+    // The bound is evaluated once, here, and turned into the last integer
+    // the condition can accept. NaN compares false, so it gets a bound that
+    // fails on the first test.
+    boundExpr->accept(this);
+    llvm::Value* bound = valueStack.top();
+    valueStack.pop();
+    if (!bound->getType()->isDoubleTy()) {
+        return false;
+    }
+    llvm::Type* int64Type = llvm::Type::getInt64Ty(*context);
+    llvm::Intrinsic::ID rounding = ascending == inclusive ? llvm::Intrinsic::floor : llvm::Intrinsic::ceil;
+    llvm::Value* intBound = builder->CreateIntrinsic(llvm::Intrinsic::fptosi_sat, {int64Type, bound->getType()},
+                                                     {builder->CreateUnaryIntrinsic(rounding, bound)});
+    int64_t nanBound = (int64_t)start + (inclusive ? (ascending ? -1 : 1) : 0);
+    llvm::Value* isNaN = builder->CreateFCmpUNO(bound, bound);
+    intBound = builder->CreateSelect(isNaN, getInt64(nanBound), intBound, "for.bound");
+    
+    llvm::Function* function = builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock* preheader = builder->GetInsertBlock();
+    llvm::BasicBlock* condBlock = llvm::BasicBlock::Create(*context, "for.cond", function);
+    llvm::BasicBlock* bodyBlock = llvm::BasicBlock::Create(*context, "for.body", function);
+    llvm::BasicBlock* updateBlock = llvm::BasicBlock::Create(*context, "for.update", function);
+    llvm::BasicBlock* endBlock = llvm::BasicBlock::Create(*context, "for.end", function);
+    
+    builder->CreateBr(condBlock);
+    
+    // Condition block: the i64 counter drives the loop, and the variable the
+    // body sees is its double image
+    builder->SetInsertPoint(condBlock);
+    llvm::PHINode* counter = builder->CreatePHI(int64Type, 2, name + ".iv");
+    counter->addIncoming(getInt64((int64_t)start), preheader);
+    builder->CreateStore(builder->CreateSIToFP(counter, llvm::Type::getDoubleTy(*context)), variable);
+    llvm::Value* keepGoing;
+    if (ascending) {
+        keepGoing = inclusive ? builder->CreateICmpSLE(counter, intBound) : builder->CreateICmpSLT(counter, intBound);
+    } else {
+        keepGoing = inclusive ? builder->CreateICmpSGE(counter, intBound) : builder->CreateICmpSGT(counter, intBound);
+    }
+    builder->CreateCondBr(keepGoing, bodyBlock, endBlock);
+    
+    // Body block
+    builder->SetInsertPoint(bodyBlock);
+    loopTargets.push_back({endBlock, updateBlock});
     node->body->accept(this);
+    loopTargets.pop_back();
     if (!builder->GetInsertBlock()->getTerminator()) {
-        builder->CreateBr(condBlock);
+        builder->CreateBr(updateBlock);
     }
     
+    // Update block
+    builder->SetInsertPoint(updateBlock);
+    int64_t delta = ascending ? (int64_t)step : -(int64_t)step;
+    llvm::Value* next = builder->CreateAdd(counter, getInt64(delta), name + ".next", false, true);
+    counter->addIncoming(next, updateBlock);
+    attachLoopHints(builder->CreateBr(condBlock), node->hints);
+    
     // End block
     builder->SetInsertPoint(endBlock);
+    return true;
 }
 
 void CodeGenerator::visit(ForStatement* node) {
     llvm::Function* function = builder->GetInsertBlock()->getParent();
+    functionsWithLoops.insert(function);
+    
+    llvm::IRBuilderBase::FastMathFlagGuard fastMathGuard(*builder);
+    if (node->hints.fastMath) {
+        builder->setFastMathFlags(relaxedMathFlags());
+    }
     
     // Init
     if (node->init) {
         node->init->accept(this);
     }
+    joinLoopVariableKinds({node->condition.get(), node->update.get(), node->body.get()});
+    
+    if (emitCountedFor(node)) {
+        return;
+    }
     
     llvm::BasicBlock* condBlock = llvm::BasicBlock::Create(*context, "for.cond", function);
     llvm::BasicBlock* bodyBlock = llvm::BasicBlock::Create(*context, "for.body", function);
@@ -2453,7 +3615,9 @@ void CodeGenerator::visit(ForStatement* node) {
     
     // Body block
     builder->SetInsertPoint(bodyBlock);
+    loopTargets.push_back({endBlock, updateBlock});
     node->body->accept(this);
+    loopTargets.pop_back();
     if (!builder->GetInsertBlock()->getTerminator()) {
         builder->CreateBr(updateBlock);
     }
@@ -2466,10 +3630,302 @@ void CodeGenerator::visit(ForStatement* node) {
             valueStack.pop(); // Discard result
         }
     }
+    attachLoopHints(builder->CreateBr(condBlock), node->hints);
+    
+    // End block
+    builder->SetInsertPoint(endBlock);
+}
+
+void CodeGenerator::visit(ForInStatement* node) {
+    llvm::Function* function = builder->GetInsertBlock()->getParent();
+    functionsWithLoops.insert(function);
+    
+    llvm::IRBuilderBase::FastMathFlagGuard fastMathGuard(*builder);
+    if (node->hints.fastMath) {
+        builder->setFastMathFlags(relaxedMathFlags());
+    }
+    
+    llvm::Type* doubleType = llvm::Type::getDoubleTy(*context);
+    llvm::Type* int64Type = llvm::Type::getInt64Ty(*context);
+    llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+    
+    // A range() is never built: the loop counts through it directly
+    CallExpression* range = asRangeCall(node->iterable.get());
+    llvm::Value* iterable = nullptr;
+    llvm::Value* rangeStart = nullptr;
+    llvm::Value* rangeStep = nullptr;
+    llvm::Value* count = nullptr;
+    ValueKind kind = ValueKind::Number;
+    if (range) {
+        createRangeBounds(range, rangeStart, rangeStep, count);
+    } else {
+        node->iterable->accept(this);
+        iterable = valueStack.top();
+        valueStack.pop();
+        if (!iterable->getType()->isPointerTy()) {
+            throw std::runtime_error("for-in needs an array, a string or a range()");
+        }
+        kind = expressionKind(node->iterable.get());
+    }
+    
+    // The length is read once. Strings and arrays with whole-byte elements
+    // walk a pointer up to the end; bit arrays and arrays whose element type
+    // is only known at runtime count an index instead.
+    llvm::Type* elementType = nullptr;
+    switch (kind) {
+        case ValueKind::String:
+            elementType = builder->getInt8Ty();
+            count = builder->CreateCall(module->getFunction("strlen"), {iterable}, "length");
+            break;
+        case ValueKind::Array:
+            elementType = doubleType;
+            break;
+        case ValueKind::Int32Array:
+            elementType = builder->getInt32Ty();
+            break;
+        case ValueKind::Int64Array:
+            elementType = int64Type;
+            break;
+        case ValueKind::Float32Array:
+            elementType = builder->getFloatTy();
+            break;
+        case ValueKind::BitArray:
+        case ValueKind::AnyArray:
+        case ValueKind::Number:
+            break;
+        default: {
+            llvm::Function* lenFunc = declareRuntimeFunction("twine_len", doubleType, {ptrType});
+            count = toCount(builder->CreateCall(lenFunc, {iterable}));
+            break;
+        }
+    }
+    if (!count) {
+        count = loadArrayCount(iterable);
+    }
+    bool pointerWalk = elementType != nullptr;
+    llvm::Value* end = pointerWalk ? builder->CreateInBoundsGEP(elementType, iterable, count, "end") : count;
+    
+    pushScope();
+    // Strings give one-character strings; a value of unknown kind gives
+    // whatever twine_element_at finds, boxed
+    bool unknownKind = kind == ValueKind::Unknown;
+    ValueKind elementKind = kind == ValueKind::String || unknownKind ? kind : ValueKind::Number;
+    llvm::AllocaInst* variable = createEntryBlockAlloca(currentFunction, node->name,
+                                                        elementKind == ValueKind::Number ? doubleType : ptrType);
+    symbolTables.back()[node->name] = variable;
+    variableKinds[variable] = elementKind;
+    joinLoopVariableKinds({node->body.get()});
+    
+    llvm::BasicBlock* preheader = builder->GetInsertBlock();
+    llvm::BasicBlock* condBlock = llvm::BasicBlock::Create(*context, "forin.cond", function);
+    llvm::BasicBlock* bodyBlock = llvm::BasicBlock::Create(*context, "forin.body", function);
+    llvm::BasicBlock* updateBlock = llvm::BasicBlock::Create(*context, "forin.update", function);
+    llvm::BasicBlock* endBlock = llvm::BasicBlock::Create(*context, "forin.end", function);
+    
     builder->CreateBr(condBlock);
     
+    // Condition block
+    builder->SetInsertPoint(condBlock);
+    llvm::PHINode* cursor = builder->CreatePHI(pointerWalk ? ptrType : int64Type, 2, node->name + ".cursor");
+    cursor->addIncoming(pointerWalk ? iterable : getInt64(0), preheader);
+    builder->CreateCondBr(builder->CreateICmpNE(cursor, end), bodyBlock, endBlock);
+    
+    // Body block: load the element into the loop variable
+    builder->SetInsertPoint(bodyBlock);
+    llvm::Value* element;
+    if (kind == ValueKind::String) {
+        llvm::Type* int32Type = builder->getInt32Ty();
+        llvm::Function* byteFunc = declareRuntimeFunction("twine_byte_string", ptrType, {int32Type});
+        element = builder->CreateCall(byteFunc, {builder->CreateZExt(builder->CreateLoad(builder->getInt8Ty(), cursor), int32Type)});
+    } else if (pointerWalk) {
+        element = createElementLoad(kind, cursor, nullptr);
+    } else if (kind == ValueKind::BitArray) {
+        element = createElementLoad(kind, createElementAddress(kind, iterable, cursor), cursor);
+    } else if (range) {
+        element = builder->CreateFAdd(rangeStart, builder->CreateFMul(builder->CreateUIToFP(cursor, doubleType), rangeStep));
+    } else if (unknownKind) {
+        llvm::Function* elementFunc = declareRuntimeFunction("twine_element_at", ptrType, {ptrType, doubleType});
+        element = builder->CreateCall(elementFunc, {iterable, builder->CreateUIToFP(cursor, doubleType)});
+    } else {
+        llvm::Function* getFunc = declareRuntimeFunction("twine_array_get", doubleType, {ptrType, doubleType});
+        element = builder->CreateCall(getFunc, {iterable, builder->CreateUIToFP(cursor, doubleType)});
+    }
+    builder->CreateStore(element, variable);
+    loopTargets.push_back({endBlock, updateBlock});
+    node->body->accept(this);
+    loopTargets.pop_back();
+    if (!builder->GetInsertBlock()->getTerminator()) {
+        builder->CreateBr(updateBlock);
+    }
+    
+    // Update block
+    builder->SetInsertPoint(updateBlock);
+    llvm::Value* next = pointerWalk
+        ? builder->CreateInBoundsGEP(elementType, cursor, getInt64(1), node->name + ".next")
+        : builder->CreateAdd(cursor, getInt64(1), node->name + ".next", true, true);
+    cursor->addIncoming(next, updateBlock);
+    attachLoopHints(builder->CreateBr(condBlock), node->hints);
+    
     // End block
     builder->SetInsertPoint(endBlock);
+    popScope();
+}
+
+// A case label that is an integer literal, possibly negated
+static bool isIntegerCaseLabel(Expression* expr, int64_t& value) {
+    double number = 0.0;
+    auto* unary = dynamic_cast<UnaryExpression*>(expr);
+    if (unary && unary->op == "-" && isExactIntegerLiteral(unary->operand.get(), number)) {
+        value = -(int64_t)number;
+        return true;
+    }
+    if (isExactIntegerLiteral(expr, number)) {
+        value = (int64_t)number;
+        return true;
+    }
+    return false;
+}
+
+void CodeGenerator::visit(SwitchStatement* node) {
+    node->discriminant->accept(this);
+    llvm::Value* discriminant = valueStack.top();
+    valueStack.pop();
+    
+    llvm::Function* function = builder->GetInsertBlock()->getParent();
+    llvm::Type* int64Type = llvm::Type::getInt64Ty(*context);
+    llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+    
+    std::vector<llvm::BasicBlock*> caseBlocks;
+    llvm::BasicBlock* endBlock = llvm::BasicBlock::Create(*context, "switch.end");
+    llvm::BasicBlock* defaultBlock = endBlock;
+    bool isString = expressionKind(node->discriminant.get()) == ValueKind::String;
+    bool integerLabels = discriminant->getType()->isDoubleTy();
+    bool stringLabels = discriminant->getType()->isPointerTy() && isString;
+    for (auto& switchCase : node->cases) {
+        caseBlocks.push_back(llvm::BasicBlock::Create(*context, switchCase.value ? "switch.case" : "switch.default"));
+        if (!switchCase.value) {
+            defaultBlock = caseBlocks.back();
+            continue;
+        }
+        int64_t label = 0;
+        integerLabels = integerLabels && isIntegerCaseLabel(switchCase.value.get(), label);
+        stringLabels = stringLabels && dynamic_cast<StringLiteral*>(switchCase.value.get());
+    }
+    
+    if (integerLabels) {
+        // A number matches only if it is exactly an integer, so anything
+        // else goes straight to default; integers dispatch through a
+        // SwitchInst, which the backend can turn into a jump table
+        llvm::Value* asInteger = builder->CreateIntrinsic(llvm::Intrinsic::fptosi_sat, {int64Type, discriminant->getType()},
+                                                          {discriminant});
+        llvm::Value* isInteger = builder->CreateFCmpOEQ(builder->CreateSIToFP(asInteger, discriminant->getType()), discriminant);
+        llvm::BasicBlock* dispatchBlock = llvm::BasicBlock::Create(*context, "switch.dispatch", function);
+        builder->CreateCondBr(isInteger, dispatchBlock, defaultBlock);
+        
+        builder->SetInsertPoint(dispatchBlock);
+        llvm::SwitchInst* dispatch = builder->CreateSwitch(asInteger, defaultBlock, node->cases.size());
+        std::set<int64_t> seen;
+        for (size_t i = 0; i < node->cases.size(); i++) {
+            int64_t label = 0;
+            // Like an if/else chain, the first of two equal labels wins
+            if (node->cases[i].value && isIntegerCaseLabel(node->cases[i].value.get(), label) && seen.insert(label).second) {
+                dispatch->addCase(llvm::cast<llvm::ConstantInt>(getInt64(label)), caseBlocks[i]);
+            }
+        }
+    } else if (stringLabels) {
+        // Switch on the string's hash, then confirm with a compare against
+        // each label sharing that hash
+        llvm::Function* hashFunc = declareRuntimeFunction("twine_str_hash", int64Type, {ptrType});
+        llvm::Function* eqFunc = declareRuntimeFunction("twine_str_eq", llvm::Type::getInt32Ty(*context), {ptrType, ptrType});
+        llvm::Value* hash = builder->CreateCall(hashFunc, {discriminant}, "hash");
+        llvm::SwitchInst* dispatch = builder->CreateSwitch(hash, defaultBlock, node->cases.size());
+        
+        std::map<uint64_t, llvm::BasicBlock*> hashBlocks;
+        for (size_t i = 0; i < node->cases.size(); i++) {
+            auto* label = static_cast<StringLiteral*>(node->cases[i].value.get());
+            if (!label) continue;
+            uint64_t labelHash = hashBytes(label->value.data(), label->value.size());
+            llvm::BasicBlock*& testBlock = hashBlocks[labelHash];
+            if (!testBlock) {
+                testBlock = llvm::BasicBlock::Create(*context, "switch.hash", function);
+                dispatch->addCase(llvm::cast<llvm::ConstantInt>(getInt64((int64_t)labelHash)), testBlock);
+            } else {
+                // Collision: extend the compare chain for this hash
+                llvm::BasicBlock* nextTest = llvm::BasicBlock::Create(*context, "switch.hash", function);
+                llvm::BranchInst* miss = llvm::cast<llvm::BranchInst>(testBlock->getTerminator());
+                miss->setSuccessor(1, nextTest);
+                testBlock = nextTest;
+            }
+            builder->SetInsertPoint(testBlock);
+            label->accept(this);
+            llvm::Value* labelValue = valueStack.top();
+            valueStack.pop();
+            llvm::Value* equal = builder->CreateICmpNE(builder->CreateCall(eqFunc, {discriminant, labelValue}), getInt32(0));
+            builder->CreateCondBr(equal, caseBlocks[i], defaultBlock);
+        }
+    } else {
+        // Labels that aren't all constants of one type are tried in order
+        for (size_t i = 0; i < node->cases.size(); i++) {
+            if (!node->cases[i].value) continue;
+            node->cases[i].value->accept(this);
+            llvm::Value* label = valueStack.top();
+            valueStack.pop();
+            
+            llvm::Value* equal;
+            if (label->getType() != discriminant->getType()) {
+                equal = builder->getFalse();
+            } else if (label->getType()->isDoubleTy()) {
+                equal = builder->CreateFCmpOEQ(discriminant, label);
+            } else if (isString || expressionKind(node->cases[i].value.get()) == ValueKind::String) {
+                llvm::Function* eqFunc = declareRuntimeFunction("twine_str_eq", llvm::Type::getInt32Ty(*context), {ptrType, ptrType});
+                equal = builder->CreateICmpNE(builder->CreateCall(eqFunc, {discriminant, label}), getInt32(0));
+            } else {
+                equal = builder->CreateICmpEQ(discriminant, label);
+            }
+            llvm::BasicBlock* nextTest = llvm::BasicBlock::Create(*context, "switch.test", function);
+            builder->CreateCondBr(equal, caseBlocks[i], nextTest);
+            builder->SetInsertPoint(nextTest);
+        }
+        builder->CreateBr(defaultBlock);
+    }
+    
+    // Case bodies, in source order so each can fall through to the next
+    pushScope();
+    loopTargets.push_back({endBlock, nullptr});
+    for (size_t i = 0; i < node->cases.size(); i++) {
+        caseBlocks[i]->insertInto(function);
+        builder->SetInsertPoint(caseBlocks[i]);
+        for (auto& statement : node->cases[i].body) {
+            statement->accept(this);
+        }
+        if (!builder->GetInsertBlock()->getTerminator()) {
+            builder->CreateBr(i + 1 < caseBlocks.size() ? caseBlocks[i + 1] : endBlock);
+        }
+    }
+    loopTargets.pop_back();
+    popScope();
+    
+    endBlock->insertInto(function);
+    builder->SetInsertPoint(endBlock);
+}
+
+void CodeGenerator::visit(BreakStatement*) {
+    if (loopTargets.empty()) {
+        throw std::runtime_error("break outside of a loop or switch");
+    }
+    builder->CreateBr(loopTargets.back().breakBlock);
+    // Anything after the jump is unreachable; give it a block of its own
+    builder->SetInsertPoint(llvm::BasicBlock::Create(*context, "after.break", currentFunction));
+}
+
+void CodeGenerator::visit(ContinueStatement*) {
+    auto loop = std::find_if(loopTargets.rbegin(), loopTargets.rend(),
+                             [](const LoopTarget& target) { return target.continueBlock != nullptr; });
+    if (loop == loopTargets.rend()) {
+        throw std::runtime_error("continue outside of a loop");
+    }
+    builder->CreateBr(loop->continueBlock);
+    builder->SetInsertPoint(llvm::BasicBlock::Create(*context, "after.continue", currentFunction));
 }
 
 void CodeGenerator::visit(ReturnStatement* node) {
@@ -2558,9 +4014,14 @@ void CodeGenerator::visit(FunctionDeclaration* node) {
                                                           llvm::Type::getDoubleTy(*context));
         builder->CreateStore(arg, alloca);
         symbolTables.back()[node->parameters[i]] = alloca;
+        variableKinds[alloca] = ValueKind::Number;
     }
     
+    // A loop around the declaration isn't one the body can break out of
+    std::vector<LoopTarget> enclosingLoops;
+    enclosingLoops.swap(loopTargets);
     node->body->accept(this);
+    loopTargets.swap(enclosingLoops);
      
     if (!builder->GetInsertBlock()->getTerminator()) {
         llvm::Value* nullValue = llvm::ConstantPointerNull::get(llvm::PointerType::getUnqual(*context));
@@ -2667,78 +4128,83 @@ void CodeGenerator::declareStrstr() {
     llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, "strstr", *module);
 }
 
-llvm::Value* CodeGenerator::convertToString(llvm::Value* value) {
-    if (value->getType()->isPointerTy()) {
-        return value;
+void CodeGenerator::markMathFunction(llvm::Function* func) {
+    // Twine never reads errno, so libm calls are pure as far as the program
+    // can tell, which lets LLVM hoist, merge and vectorize them
+    func->setDoesNotAccessMemory();
+    func->setDoesNotThrow();
+    func->setWillReturn();
+}
+
+llvm::Value* CodeGenerator::createMathCall(llvm::Function* func, const std::vector<llvm::Value*>& args) {
+    return builder->CreateCall(func, args);
+}
+
+void CodeGenerator::setGlibcVersion(int major, int minor) {
+    glibcVersion = major * 100 + minor;
+}
+
+void CodeGenerator::emitVectorMathVariants() {
+    // glibc's libmvec has 2-lane SSE2 versions the loop vectorizer can call
+    // (libm.so pulls libmvec in as needed). Whether they exist depends on
+    // the target, not on the machine running the compiler. The AVX2
+    // variants aren't offered because the generated code doesn't assume an
+    // AVX2 target.
+    llvm::Triple triple(module->getTargetTriple().empty() ? LLVM_DEFAULT_TARGET_TRIPLE
+                                                          : module->getTargetTriple());
+    if (triple.getArch() != llvm::Triple::x86_64 || !triple.isGNUEnvironment()) {
+        return;
     }
     
-    if (!value->getType()->isDoubleTy()) {
-        value = convertToDouble(value);
+    std::vector<std::string> names = {"sin", "cos", "pow"};
+    // _ZGVbN2v_tan first shipped in glibc 2.35
+    if (glibcVersion >= 235) {
+        names.push_back("tan");
     }
-    llvm::Type* charType = llvm::Type::getInt8Ty(*context);
-    llvm::Type* arrayType = llvm::ArrayType::get(charType, 32);
-    llvm::AllocaInst* buffer = builder->CreateAlloca(arrayType, nullptr, "str_buffer");
-    
-    std::vector<llvm::Value*> indices = {
-        llvm::ConstantInt::get(*context, llvm::APInt(32, 0)),
-        llvm::ConstantInt::get(*context, llvm::APInt(32, 0))
-    };
-    llvm::Value* bufferPtr = builder->CreateInBoundsGEP(
-        arrayType,
-        buffer,
-        indices
-    );
     
-    llvm::GlobalVariable* format = builder->CreateGlobalString("%g");
-    std::vector<llvm::Value*> formatIndices = {
-        llvm::ConstantInt::get(*context, llvm::APInt(32, 0)),
-        llvm::ConstantInt::get(*context, llvm::APInt(32, 0))
-    };
-    llvm::Value* formatPtr = builder->CreateInBoundsGEP(
-        format->getValueType(),
-        format,
-        formatIndices
-    );
-    
-    llvm::Function* snprintfFunc = module->getFunction("snprintf");
-    builder->CreateCall(snprintfFunc, {
-        bufferPtr,
-        llvm::ConstantInt::get(*context, llvm::APInt(32, 32)),
-        formatPtr,
-        value
-    });
+    for (const std::string& name : names) {
+        llvm::Function* func = module->getFunction(name);
+        if (!func || func->use_empty()) {
+            continue;
+        }
+        
+        llvm::Type* vectorType = llvm::FixedVectorType::get(llvm::Type::getDoubleTy(*context), 2);
+        std::vector<llvm::Type*> vectorParams(func->arg_size(), vectorType);
+        std::string vectorName = "_ZGVbN2" + std::string(func->arg_size(), 'v') + "_" + name;
+        llvm::Function* vectorFunc = declareRuntimeFunction(vectorName, vectorType, vectorParams);
+        vectorFunc->setDoesNotAccessMemory();
+        vectorFunc->setDoesNotThrow();
+        vectorFunc->setWillReturn();
+        
+        // The vectorizer only considers variants that are declared in the
+        // module, and looks for the mapping on the call, not the callee
+        llvm::appendToCompilerUsed(*module, {vectorFunc});
+        std::string mapping = vectorName + "(" + vectorName + ")";
+        func->addFnAttr("vector-function-abi-variant", mapping);
+        for (llvm::User* user : func->users()) {
+            if (auto* call = llvm::dyn_cast<llvm::CallInst>(user)) {
+                call->addFnAttr(llvm::Attribute::get(*context, "vector-function-abi-variant", mapping));
+            }
+        }
+    }
+}
+
+llvm::Function* CodeGenerator::declareRuntimeFunction(const std::string& name,
+                                                      llvm::Type* returnType,
+                                                      const std::vector<llvm::Type*>& params) {
+    if (llvm::Function* existing = module->getFunction(name)) return existing;
     
-    return bufferPtr;
+    llvm::FunctionType* funcType = llvm::FunctionType::get(returnType, params, false);
+    return llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, name, *module);
 }
 
 llvm::Value* CodeGenerator::createStringConcatenation(llvm::Value* left, llvm::Value* right) {
-    declareStrlen();
-    declareMalloc();
-    declareStrcpy();
-    declareStrcat();
-    if (!left->getType()->isPointerTy()) {
-        left = convertToString(left);
-    }
-    if (!right->getType()->isPointerTy()) {
-        right = convertToString(right);
-    }
-    
-    llvm::Function* strlenFunc = module->getFunction("strlen");
-    llvm::Value* leftLen = builder->CreateCall(strlenFunc, {left}, "leftlen");
-    llvm::Value* rightLen = builder->CreateCall(strlenFunc, {right}, "rightlen");
-    
-    llvm::Value* totalLen = builder->CreateAdd(leftLen, rightLen, "addlen");
-    totalLen = builder->CreateAdd(totalLen, llvm::ConstantInt::get(*context, llvm::APInt(64, 1)), "totallen");
-    llvm::Function* mallocFunc = module->getFunction("malloc");
-    llvm::Value* resultPtr = builder->CreateCall(mallocFunc, {totalLen}, "result");
-    
-    llvm::Type* charPtrType = llvm::PointerType::getUnqual(*context);
-    resultPtr = builder->CreateBitCast(resultPtr, charPtrType, "resultstr");
-    llvm::Function* strcpyFunc = module->getFunction("strcpy");
-    builder->CreateCall(strcpyFunc, {resultPtr, left});
-    
-    llvm::Function* strcatFunc = module->getFunction("strcat");
-    builder->CreateCall(strcatFunc, {resultPtr, right});
-    
-    return resultPtr;
+    // Either side may be a boxed number (e.g. a function result), which only
+    // the runtime can tell apart from a string, so numbers are boxed too:
+    // twine_concat adds two boxes and formats one next to a string like str()
+    if (!left->getType()->isPointerTy()) left = boxValue(convertToDouble(left));
+    if (!right->getType()->isPointerTy()) right = boxValue(convertToDouble(right));
+    llvm::Type* ptrType = llvm::PointerType::getUnqual(*context);
+    llvm::Function* concatFunc = declareRuntimeFunction("twine_concat", ptrType, {ptrType, ptrType});
+    return builder->CreateCall(concatFunc, {left, right});
 }
\ No newline at end of file
@@ -15,6 +15,12 @@ void Lexer::initKeywords() {
     keywords["else"] = TokenType::ELSE;
     keywords["while"] = TokenType::WHILE;
     keywords["for"] = TokenType::FOR;
+    keywords["in"] = TokenType::IN;
+    keywords["break"] = TokenType::BREAK;
+    keywords["continue"] = TokenType::CONTINUE;
+    keywords["switch"] = TokenType::SWITCH;
+    keywords["case"] = TokenType::CASE;
+    keywords["default"] = TokenType::DEFAULT;
     keywords["return"] = TokenType::RETURN;
     keywords["true"] = TokenType::TRUE;
     keywords["false"] = TokenType::FALSE;
@@ -194,6 +200,10 @@ Token Lexer::nextToken() {
             return Token(TokenType::LOGICAL_NOT, "!", startLine, startColumn);
             
         case '<':
+            if (peek() == '<') {
+                advance();
+                return Token(TokenType::SHIFT_LEFT, "<<", startLine, startColumn);
+            }
             if (peek() == '=') {
                 advance();
                 return Token(TokenType::LESS_EQUAL, "<=", startLine, startColumn);
@@ -201,6 +211,14 @@ Token Lexer::nextToken() {
             return Token(TokenType::LESS_THAN, "<", startLine, startColumn);
             
         case '>':
+            if (peek() == '>') {
+                advance();
+                if (peek() == '>') {
+                    advance();
+                    return Token(TokenType::SHIFT_RIGHT_UNSIGNED, ">>>", startLine, startColumn);
+                }
+                return Token(TokenType::SHIFT_RIGHT, ">>", startLine, startColumn);
+            }
             if (peek() == '=') {
                 advance();
                 return Token(TokenType::GREATER_EQUAL, ">=", startLine, startColumn);
@@ -212,14 +230,22 @@ Token Lexer::nextToken() {
                 advance();
                 return Token(TokenType::LOGICAL_AND, "&&", startLine, startColumn);
             }
-            break;
+            return Token(TokenType::BIT_AND, "&", startLine, startColumn);
             
         case '|':
             if (peek() == '|') {
                 advance();
                 return Token(TokenType::LOGICAL_OR, "||", startLine, startColumn);
             }
-            break;
+            return Token(TokenType::BIT_OR, "|", startLine, startColumn);
+            
+        case '~':
+            // `//` already starts a comment, so integer division is `~/`
+            if (peek() == '/') {
+                advance();
+                return Token(TokenType::INT_DIVIDE, "~/", startLine, startColumn);
+            }
+            return Token(TokenType::BIT_NOT, "~", startLine, startColumn);
             
         case '/':
             if (peek() == '/') {
@@ -231,15 +257,54 @@ Token Lexer::nextToken() {
                 skipBlockComment();
                 return nextToken();
             }
+            if (peek() == '=') {
+                advance();
+                return Token(TokenType::DIVIDE_ASSIGN, "/=", startLine, startColumn);
+            }
             return Token(TokenType::DIVIDE, "/", startLine, startColumn);
             
+        case '+':
+            if (peek() == '+') {
+                advance();
+                return Token(TokenType::INCREMENT, "++", startLine, startColumn);
+            }
+            if (peek() == '=') {
+                advance();
+                return Token(TokenType::PLUS_ASSIGN, "+=", startLine, startColumn);
+            }
+            return Token(TokenType::PLUS, "+", startLine, startColumn);
+            
+        case '-':
+            if (peek() == '-') {
+                advance();
+                return Token(TokenType::DECREMENT, "--", startLine, startColumn);
+            }
+            if (peek() == '=') {
+                advance();
+                return Token(TokenType::MINUS_ASSIGN, "-=", startLine, startColumn);
+            }
+            return Token(TokenType::MINUS, "-", startLine, startColumn);
+            
+        case '*':
+            if (peek() == '=') {
+                advance();
+                return Token(TokenType::MULTIPLY_ASSIGN, "*=", startLine, startColumn);
+            }
+            return Token(TokenType::MULTIPLY, "*", startLine, startColumn);
+            
+        case '%':
+            if (peek() == '=') {
+                advance();
+                return Token(TokenType::MODULO_ASSIGN, "%=", startLine, startColumn);
+            }
+            return Token(TokenType::MODULO, "%", startLine, startColumn);
+            
         // Single-character tokens
-        case '+': return Token(TokenType::PLUS, "+", startLine, startColumn);
-        case '-': return Token(TokenType::MINUS, "-", startLine, startColumn);
-        case '*': return Token(TokenType::MULTIPLY, "*", startLine, startColumn);
-        case '%': return Token(TokenType::MODULO, "%", startLine, startColumn);
         case ';': return Token(TokenType::SEMICOLON, ";", startLine, startColumn);
         case ',': return Token(TokenType::COMMA, ",", startLine, startColumn);
+        case ':': return Token(TokenType::COLON, ":", startLine, startColumn);
+        case '^': return Token(TokenType::BIT_XOR, "^", startLine, startColumn);
+        case '?': return Token(TokenType::QUESTION, "?", startLine, startColumn);
         case '.': return Token(TokenType::DOT, ".", startLine, startColumn);
         case '(': return Token(TokenType::LEFT_PAREN, "(", startLine, startColumn);
         case ')': return Token(TokenType::RIGHT_PAREN, ")", startLine, startColumn);
@@ -247,6 +312,7 @@ Token Lexer::nextToken() {
         case '}': return Token(TokenType::RIGHT_BRACE, "}", startLine, startColumn);
         case '[': return Token(TokenType::LEFT_BRACKET, "[", startLine, startColumn);
         case ']': return Token(TokenType::RIGHT_BRACKET, "]", startLine, startColumn);
+        case '@': return Token(TokenType::AT, "@", startLine, startColumn);
         
         case '"':
         case '\'':
@@ -8,6 +8,7 @@
 #include <memory>
 #include <cstdlib>
 #include <filesystem>
+#include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -46,6 +47,29 @@ std::string getOutputExecutable(const std::string& baseName) {
 #endif
 }
 
+// Locate a runtime library file (twinert.bc / libtwinert.a). Looks in
+// $TWINE_RUNTIME_DIR, then the build's runtime directory, then next to the
+// compiler executable.
+std::string findRuntimeFile(const std::string& fileName, const std::string& programPath) {
+    std::vector<std::filesystem::path> searchDirs;
+    if (const char* envDir = std::getenv("TWINE_RUNTIME_DIR")) {
+        searchDirs.push_back(envDir);
+    }
+#ifdef TWINE_RUNTIME_DIR
+    searchDirs.push_back(TWINE_RUNTIME_DIR);
+#endif
+    searchDirs.push_back(std::filesystem::path(programPath).parent_path());
+    
+    for (const auto& dir : searchDirs) {
+        std::filesystem::path candidate = dir / fileName;
+        std::error_code ec;
+        if (std::filesystem::exists(candidate, ec)) {
+            return candidate.string();
+        }
+    }
+    return "";
+}
+
 int runCommand(const std::string& command) {
     std::cout << "Running: " << command << std::endl;
     int result = std::system(command.c_str());
@@ -62,6 +86,11 @@ void printUsage(const std::string& programName) {
     std::cout << "  --emit-ir      Output LLVM IR only" << std::endl;
     std::cout << "  --emit-asm     Output assembly only" << std::endl;
     std::cout << "  --emit-obj     Output object file only" << std::endl;
+    std::cout << "  --fast-math    Allow floating-point reassociation and contraction" << std::endl;
+    std::cout << "  --target-clones=<isas>" << std::endl;
+    std::cout << "                 Also compile loops for sse4.2, avx2 and/or avx512f and pick at load time" << std::endl;
+    std::cout << "  --glibc=<version>" << std::endl;
+    std::cout << "                 Oldest glibc the program runs on, e.g. 2.35 (enables more libmvec calls)" << std::endl;
     std::cout << "  --verbose      Enable verbose output" << std::endl;
     std::cout << "  --version      Show version information" << std::endl;
     std::cout << "  --help         Show this help message" << std::endl;
@@ -79,6 +108,10 @@ int main(int argc, char* argv[]) {
     bool emitAsm = false;
     bool emitObj = false;
     bool verbose = false;
+    bool fastMath = false;
+    std::vector<std::string> targetClones;
+    int glibcMajor = 0;
+    int glibcMinor = 0;
     
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
@@ -95,6 +128,25 @@ int main(int argc, char* argv[]) {
             emitAsm = true;
         } else if (arg == "--emit-obj") {
             emitObj = true;
+        } else if (arg == "--fast-math") {
+            fastMath = true;
+        } else if (arg.rfind("--target-clones=", 0) == 0) {
+#if !defined(__linux__) || !defined(__x86_64__)
+            std::cerr << "Error: --target-clones needs ELF ifunc support (Linux x86-64)" << std::endl;
+            return 1;
+#endif
+            std::stringstream isas(arg.substr(std::string("--target-clones=").size()));
+            std::string isa;
+            while (std::getline(isas, isa, ',')) {
+                if (!isa.empty()) targetClones.push_back(isa);
+            }
+        } else if (arg.rfind("--glibc=", 0) == 0) {
+            char dot = 0;
+            std::stringstream version(arg.substr(std::string("--glibc=").size()));
+            if (!(version >> glibcMajor >> dot >> glibcMinor) || dot != '.') {
+                std::cerr << "Error: --glibc expects a version like 2.35" << std::endl;
+                return 1;
+            }
         } else if (arg == "--verbose") {
             verbose = true;
         } else if (arg == "--version" || arg == "-v") {
@@ -151,12 +203,34 @@ int main(int argc, char* argv[]) {
         if (verbose) std::cout << "Generating LLVM IR..." << std::endl;
         std::string baseName = getBaseName(inputFile);
         CodeGenerator codegen(baseName);
+        codegen.setFastMath(fastMath);
+        if (!codegen.setTargetClones(targetClones)) {
+            return 1;
+        }
+        codegen.setGlibcVersion(glibcMajor, glibcMinor);
         
         if (!codegen.generate(ast.get())) {
             std::cerr << "Code generation failed" << std::endl;
             return 1;
         }
         
+        // Link the runtime bitcode before optimization so builtins can be inlined
+        std::string runtimeBitcode = findRuntimeFile("twinert.bc", argv[0]);
+        if (!runtimeBitcode.empty()) {
+            if (verbose) std::cout << "Linking runtime bitcode: " << runtimeBitcode << std::endl;
+            if (!codegen.linkRuntime(runtimeBitcode)) {
+                return 1;
+            }
+        } else if (verbose) {
+            std::cout << "Runtime bitcode not found, builtins will be linked from libtwinert.a" << std::endl;
+        }
+        
+        // The runtime bitcode carries the target triple the variants depend on
+        codegen.emitVectorMathVariants();
+        
+        // Clone after linking so inlined runtime code is compiled per ISA too
+        codegen.emitTargetClones();
+        
         // Write LLVM IR to file
         std::string irFile = baseName + ".ll";
         std::string originalIrFile = irFile;  // Keep track of original IR file
@@ -216,29 +290,31 @@ int main(int argc, char* argv[]) {
             outputFile = getOutputExecutable(baseName);
         }
         
+        std::string runtimeArchive = findRuntimeFile("libtwinert.a", argv[0]);
+        if (runtimeArchive.empty()) {
+            std::cerr << "Warning: runtime library libtwinert.a not found, set TWINE_RUNTIME_DIR" << std::endl;
+        } else {
+            runtimeArchive = " " + runtimeArchive;
+        }
+        
         std::string linkCmd;
 #ifdef _WIN32
         // On Windows with MinGW
-        linkCmd = "gcc " + objFile + " -o " + outputFile + " -lm";
+        linkCmd = "gcc " + objFile + " -o " + outputFile + runtimeArchive + " -lm";
 #else
         // On Unix-like systems
-        linkCmd = "gcc " + objFile + " -o " + outputFile + " -lm";
+        linkCmd = "gcc " + objFile + " -o " + outputFile + runtimeArchive + " -lm";
 #endif
         
         if (verbose) std::cout << "Linking executable..." << std::endl;
         if (runCommand(linkCmd) != 0) {
-            // Try with g++ if gcc fails
-            linkCmd = "g++ " + objFile + " -o " + outputFile + " -lm";
+            // Try with g++ if gcc fails. There is no bare ld fallback: the
+            // runtime needs libgcc (__cpu_model) and the C startup files,
+            // which only a compiler driver adds.
+            linkCmd = "g++ " + objFile + " -o " + outputFile + runtimeArchive + " -lm";
             if (runCommand(linkCmd) != 0) {
-                // Try with ld directly as last resort
-                linkCmd = "ld " + objFile + " -o " + outputFile;
-#ifdef __linux__
-                linkCmd += " /lib64/ld-linux-x86-64.so.2 -lc -dynamic-linker /lib64/ld-linux-x86-64.so.2";
-#endif
-                if (runCommand(linkCmd) != 0) {
-                    std::cerr << "Linking failed" << std::endl;
-                    return 1;
-                }
+                std::cerr << "Linking failed" << std::endl;
+                return 1;
             }
         }
         
@@ -64,6 +64,10 @@ void Parser::synchronize() {
             case TokenType::IF:
             case TokenType::WHILE:
             case TokenType::RETURN:
+            case TokenType::SWITCH:
+            case TokenType::BREAK:
+            case TokenType::CONTINUE:
+            case TokenType::AT:
                 return;
             default:
                 break;
@@ -119,7 +123,10 @@ std::unique_ptr<Statement> Parser::parseStatement() {
     if (match(TokenType::IF)) return parseIfStatement();
     if (match(TokenType::WHILE)) return parseWhileStatement();
     if (match(TokenType::FOR)) return parseForStatement();
+    if (match(TokenType::AT)) return parseAnnotatedLoop();
+    if (match(TokenType::SWITCH)) return parseSwitchStatement();
     if (match(TokenType::RETURN)) return parseReturnStatement();
+    if (match({TokenType::BREAK, TokenType::CONTINUE})) return parseLoopJump();
     if (match(TokenType::LEFT_BRACE)) return parseBlockStatement();
     
     return parseExpressionStatement();
@@ -194,6 +201,18 @@ std::unique_ptr<Statement> Parser::parseWhileStatement() {
 std::unique_ptr<Statement> Parser::parseForStatement() {
     consume(TokenType::LEFT_PAREN, "Expected '(' after 'for'");
     
+    // for (let x in iterable)
+    if ((check(TokenType::LET) || check(TokenType::VAR) || check(TokenType::CONST)) &&
+        peek(1).type == TokenType::IDENTIFIER && peek(2).type == TokenType::IN) {
+        advance();
+        std::string name = advance().value;
+        advance();
+        auto iterable = parseExpression();
+        consume(TokenType::RIGHT_PAREN, "Expected ')' after for-in iterable");
+        auto body = parseStatement();
+        return std::make_unique<ForInStatement>(name, std::move(iterable), std::move(body));
+    }
+    
     std::unique_ptr<Statement> init = nullptr;
     if (match(TokenType::SEMICOLON)) {
         // No initializer
@@ -227,6 +246,88 @@ std::unique_ptr<Statement> Parser::parseForStatement() {
     );
 }
 
+std::unique_ptr<Statement> Parser::parseAnnotatedLoop() {
+    LoopHints hints;
+    
+    do {
+        Token name = consume(TokenType::IDENTIFIER, "Expected loop attribute after '@'");
+        if (name.value == "fastmath") {
+            hints.fastMath = true;
+            continue;
+        }
+        if (name.value != "vectorize" && name.value != "unroll") {
+            throw error(name, "Unknown loop attribute '@" + name.value + "'");
+        }
+        
+        consume(TokenType::LEFT_PAREN, "Expected '(' after '@" + name.value + "'");
+        Token count = consume(TokenType::NUMBER, "Expected a count in '@" + name.value + "'");
+        consume(TokenType::RIGHT_PAREN, "Expected ')' after '@" + name.value + "' count");
+        
+        int value = std::stoi(count.value);
+        if (value < 1) {
+            throw error(count, "'@" + name.value + "' count must be at least 1");
+        }
+        if (name.value == "vectorize") {
+            if ((value & (value - 1)) != 0) {
+                throw error(count, "'@vectorize' width must be a power of two");
+            }
+            hints.vectorizeWidth = value;
+        } else {
+            hints.unrollCount = value;
+        }
+    } while (match(TokenType::AT));
+    
+    if (match(TokenType::WHILE)) {
+        auto loop = parseWhileStatement();
+        static_cast<WhileStatement*>(loop.get())->hints = hints;
+        return loop;
+    }
+    if (match(TokenType::FOR)) {
+        auto loop = parseForStatement();
+        if (auto* forIn = dynamic_cast<ForInStatement*>(loop.get())) {
+            forIn->hints = hints;
+        } else {
+            static_cast<ForStatement*>(loop.get())->hints = hints;
+        }
+        return loop;
+    }
+    throw error(peek(), "Expected 'while' or 'for' after loop attributes");
+}
+
+std::unique_ptr<Statement> Parser::parseSwitchStatement() {
+    consume(TokenType::LEFT_PAREN, "Expected '(' after 'switch'");
+    auto discriminant = parseExpression();
+    consume(TokenType::RIGHT_PAREN, "Expected ')' after switch value");
+    consume(TokenType::LEFT_BRACE, "Expected '{' before switch body");
+    
+    std::vector<SwitchCase> cases;
+    bool hasDefault = false;
+    while (!check(TokenType::RIGHT_BRACE) && !isAtEnd()) {
+        SwitchCase switchCase;
+        if (match(TokenType::CASE)) {
+            switchCase.value = parseExpression();
+            consume(TokenType::COLON, "Expected ':' after case value");
+        } else if (match(TokenType::DEFAULT)) {
+            if (hasDefault) {
+                throw error(tokens[current - 1], "A switch can only have one 'default'");
+            }
+            hasDefault = true;
+            consume(TokenType::COLON, "Expected ':' after 'default'");
+        } else {
+            throw error(peek(), "Expected 'case' or 'default' in switch body");
+        }
+        
+        while (!check(TokenType::CASE) && !check(TokenType::DEFAULT) &&
+               !check(TokenType::RIGHT_BRACE) && !isAtEnd()) {
+            switchCase.body.push_back(parseStatement());
+        }
+        cases.push_back(std::move(switchCase));
+    }
+    
+    consume(TokenType::RIGHT_BRACE, "Expected '}' after switch body");
+    return std::make_unique<SwitchStatement>(std::move(discriminant), std::move(cases));
+}
+
 std::unique_ptr<Statement> Parser::parseReturnStatement() {
     std::unique_ptr<Expression> value = nullptr;
     
@@ -238,6 +339,15 @@ std::unique_ptr<Statement> Parser::parseReturnStatement() {
     return std::make_unique<ReturnStatement>(std::move(value));
 }
 
+std::unique_ptr<Statement> Parser::parseLoopJump() {
+    Token keyword = tokens[current - 1];
+    consume(TokenType::SEMICOLON, "Expected ';' after '" + keyword.value + "'");
+    if (keyword.type == TokenType::BREAK) {
+        return std::make_unique<BreakStatement>();
+    }
+    return std::make_unique<ContinueStatement>();
+}
+
 std::unique_ptr<Statement> Parser::parseBlockStatement() {
     std::vector<std::unique_ptr<Statement>> statements;
     
@@ -260,7 +370,7 @@ std::unique_ptr<Expression> Parser::parseExpression() {
 }
 
 std::unique_ptr<Expression> Parser::parseAssignment() {
-    auto expr = parseLogicalOr();
+    auto expr = parseConditional();
     
     if (match(TokenType::ASSIGN)) {
         if (auto* id = dynamic_cast<Identifier*>(expr.get())) {
@@ -277,6 +387,29 @@ std::unique_ptr<Expression> Parser::parseAssignment() {
         error(tokens[current - 1], "Invalid assignment target");
     }
     
+    if (match({TokenType::PLUS_ASSIGN, TokenType::MINUS_ASSIGN, TokenType::MULTIPLY_ASSIGN,
+               TokenType::DIVIDE_ASSIGN, TokenType::MODULO_ASSIGN})) {
+        Token op = tokens[current - 1];
+        if (!dynamic_cast<Identifier*>(expr.get()) && !dynamic_cast<IndexExpression*>(expr.get())) {
+            throw error(op, "Invalid assignment target");
+        }
+        auto value = parseAssignment();
+        return std::make_unique<CompoundAssignmentExpression>(std::move(expr), op.value.substr(0, 1), std::move(value));
+    }
+    
+    return expr;
+}
+
+std::unique_ptr<Expression> Parser::parseConditional() {
+    auto expr = parseLogicalOr();
+    
+    if (match(TokenType::QUESTION)) {
+        auto thenValue = parseAssignment();
+        consume(TokenType::COLON, "Expected ':' in conditional expression");
+        auto elseValue = parseAssignment();
+        return std::make_unique<ConditionalExpression>(std::move(expr), std::move(thenValue), std::move(elseValue));
+    }
+    
     return expr;
 }
 
@@ -293,9 +426,45 @@ std::unique_ptr<Expression> Parser::parseLogicalOr() {
 }
 
 std::unique_ptr<Expression> Parser::parseLogicalAnd() {
-    auto expr = parseEquality();
+    auto expr = parseBitwiseOr();
     
     while (match(TokenType::LOGICAL_AND)) {
+        std::string op = tokens[current - 1].value;
+        auto right = parseBitwiseOr();
+        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+    }
+    
+    return expr;
+}
+
+std::unique_ptr<Expression> Parser::parseBitwiseOr() {
+    auto expr = parseBitwiseXor();
+    
+    while (match(TokenType::BIT_OR)) {
+        std::string op = tokens[current - 1].value;
+        auto right = parseBitwiseXor();
+        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+    }
+    
+    return expr;
+}
+
+std::unique_ptr<Expression> Parser::parseBitwiseXor() {
+    auto expr = parseBitwiseAnd();
+    
+    while (match(TokenType::BIT_XOR)) {
+        std::string op = tokens[current - 1].value;
+        auto right = parseBitwiseAnd();
+        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+    }
+    
+    return expr;
+}
+
+std::unique_ptr<Expression> Parser::parseBitwiseAnd() {
+    auto expr = parseEquality();
+    
+    while (match(TokenType::BIT_AND)) {
         std::string op = tokens[current - 1].value;
         auto right = parseEquality();
         expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
@@ -317,11 +486,23 @@ std::unique_ptr<Expression> Parser::parseEquality() {
 }
 
 std::unique_ptr<Expression> Parser::parseComparison() {
-    auto expr = parseAddition();
+    auto expr = parseShift();
     
     while (match({TokenType::GREATER_THAN, TokenType::GREATER_EQUAL, 
                    TokenType::LESS_THAN, TokenType::LESS_EQUAL})) {
         std::string op = tokens[current - 1].value;
+        auto right = parseShift();
+        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+    }
+    
+    return expr;
+}
+
+std::unique_ptr<Expression> Parser::parseShift() {
+    auto expr = parseAddition();
+    
+    while (match({TokenType::SHIFT_LEFT, TokenType::SHIFT_RIGHT, TokenType::SHIFT_RIGHT_UNSIGNED})) {
+        std::string op = tokens[current - 1].value;
         auto right = parseAddition();
         expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
     }
@@ -344,7 +525,7 @@ std::unique_ptr<Expression> Parser::parseAddition() {
 std::unique_ptr<Expression> Parser::parseMultiplication() {
     auto expr = parseUnary();
     
-    while (match({TokenType::MULTIPLY, TokenType::DIVIDE, TokenType::MODULO})) {
+    while (match({TokenType::MULTIPLY, TokenType::DIVIDE, TokenType::INT_DIVIDE, TokenType::MODULO})) {
         std::string op = tokens[current - 1].value;
         auto right = parseUnary();
         expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
@@ -354,13 +535,30 @@ std::unique_ptr<Expression> Parser::parseMultiplication() {
 }
 
 std::unique_ptr<Expression> Parser::parseUnary() {
-    if (match({TokenType::LOGICAL_NOT, TokenType::MINUS})) {
+    if (match({TokenType::LOGICAL_NOT, TokenType::MINUS, TokenType::BIT_NOT})) {
         std::string op = tokens[current - 1].value;
         auto right = parseUnary();
         return std::make_unique<UnaryExpression>(op, std::move(right));
     }
     
-    return parseCall();
+    if (match({TokenType::INCREMENT, TokenType::DECREMENT})) {
+        Token op = tokens[current - 1];
+        return makeIncrement(parseUnary(), op, false);
+    }
+    
+    auto expr = parseCall();
+    if (match({TokenType::INCREMENT, TokenType::DECREMENT})) {
+        return makeIncrement(std::move(expr), tokens[current - 1], true);
+    }
+    return expr;
+}
+
+std::unique_ptr<Expression> Parser::makeIncrement(std::unique_ptr<Expression> target, const Token& op, bool postfix) {
+    if (!dynamic_cast<Identifier*>(target.get()) && !dynamic_cast<IndexExpression*>(target.get())) {
+        throw error(op, "Invalid " + std::string(op.type == TokenType::INCREMENT ? "increment" : "decrement") + " target");
+    }
+    return std::make_unique<CompoundAssignmentExpression>(std::move(target), op.value.substr(0, 1),
+                                                          std::make_unique<NumberLiteral>(1.0), postfix);
 }
 
 std::unique_ptr<Expression> Parser::parseCall() {